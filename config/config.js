@@ -51,10 +51,55 @@ var baseUrl = getQueryParam('base_url');
 var model = getQueryParam('model');
 var systemMessage = getQueryParam('system_message');
 var webSearchEnabled = getQueryParam('web_search_enabled');
+var secondaryProvider = getQueryParam('secondary_provider') || '';
+var secondaryApiKey = getQueryParam('secondary_api_key');
+var secondaryBaseUrl = getQueryParam('secondary_base_url');
+var secondaryModel = getQueryParam('secondary_model');
+var hedgeEnabled = getQueryParam('hedge_enabled');
+var hedgePercentile = getQueryParam('hedge_percentile');
+var powerSaving = getQueryParam('power_saving') || 'auto';
+var candidateModels = getQueryParam('candidate_models');
+var autoModelQuality = getQueryParam('auto_model_quality') || '';
+var resumeWakeup = getQueryParam('resume_wakeup');
+var logLevel = getQueryParam('log_level') || 'info';
+var modelLatency = [];
+try {
+  modelLatency = JSON.parse(getQueryParam('model_latency')) || [];
+} catch (e) {
+  modelLatency = [];
+}
 
 // Get return_to for emulator support (falls back to pebblejs://close# for real hardware)
 var returnTo = getQueryParam('return_to') || 'pebblejs://close#';
 
+// Fill the measured latency table, one row per candidate model
+function showModelLatency(table) {
+  function seconds(ms) {
+    return ms === null ? '-' : (ms / 1000).toFixed(2) + ' s';
+  }
+
+  if (modelLatency.length === 0) {
+    var empty = table.insertRow(-1);
+    var cell = empty.insertCell(-1);
+    cell.colSpan = 5;
+    cell.textContent = 'No measurements yet';
+    return;
+  }
+
+  modelLatency.forEach(function(entry) {
+    var row = table.insertRow(-1);
+    var tested = entry.at ? new Date(entry.at).toLocaleString() : 'Not yet';
+    if (entry.error) {
+      tested += ' (failed: ' + entry.error + ')';
+    }
+
+    [entry.model + (entry.chosen ? ' (in use)' : ''), entry.tier, seconds(entry.ttfb), seconds(entry.total), tested]
+      .forEach(function(text) {
+        row.insertCell(-1).textContent = text;
+      });
+  });
+}
+
 // Initialize form when DOM is loaded
 document.addEventListener('DOMContentLoaded', function() {
   var providerSelect = document.getElementById('provider');
@@ -64,6 +109,18 @@ document.addEventListener('DOMContentLoaded', function() {
   var modelInput = document.getElementById('model');
   var systemMessageInput = document.getElementById('system-message');
   var webSearchCheckbox = document.getElementById('web-search');
+  var secondaryProviderSelect = document.getElementById('secondary-provider');
+  var secondaryApiKeyInput = document.getElementById('secondary-api-key');
+  var secondaryBaseUrlInput = document.getElementById('secondary-base-url');
+  var secondaryModelInput = document.getElementById('secondary-model');
+  var hedgeCheckbox = document.getElementById('hedge-enabled');
+  var hedgePercentileInput = document.getElementById('hedge-percentile');
+  var powerSavingSelect = document.getElementById('power-saving');
+  var candidateModelsInput = document.getElementById('candidate-models');
+  var autoModelQualitySelect = document.getElementById('auto-model-quality');
+  var resumeWakeupCheckbox = document.getElementById('resume-wakeup');
+  var logLevelSelect = document.getElementById('log-level');
+  var secondaryFields = document.querySelectorAll('.secondary-field');
   var advancedRows = document.querySelectorAll('.advanced-field');
   var customEndpointFields = document.querySelectorAll('.custom-endpoint-field');
   var claudeOnlyFields = document.querySelectorAll('.claude-only-field');
@@ -78,6 +135,22 @@ document.addEventListener('DOMContentLoaded', function() {
   modelInput.value = model || providerDefaults[provider].model;
   systemMessageInput.value = systemMessage || defaultSystemMessage;
   webSearchCheckbox.checked = webSearchEnabled === 'true';
+  secondaryProviderSelect.value = secondaryProvider;
+  if (secondaryApiKey) {
+    secondaryApiKeyInput.value = secondaryApiKey;
+  }
+  if (secondaryProvider) {
+    secondaryBaseUrlInput.value = secondaryBaseUrl || providerDefaults[secondaryProvider].base_url;
+    secondaryModelInput.value = secondaryModel || providerDefaults[secondaryProvider].model;
+  }
+  hedgeCheckbox.checked = hedgeEnabled === 'true';
+  hedgePercentileInput.value = hedgePercentile || '';
+  powerSavingSelect.value = powerSaving;
+  candidateModelsInput.value = candidateModels || '';
+  autoModelQualitySelect.value = autoModelQuality;
+  resumeWakeupCheckbox.checked = resumeWakeup === 'true';
+  logLevelSelect.value = logLevel;
+  showModelLatency(document.getElementById('model-latency'));
 
   // Function to update form based on provider
   function updateProviderFields() {
@@ -102,6 +175,16 @@ document.addEventListener('DOMContentLoaded', function() {
     claudeOnlyFields.forEach(function(field) {
       field.style.display = (selectedProvider === 'claude') ? '' : 'none';
     });
+
+    updateSecondaryFields();
+  }
+
+  // Function to show backup provider fields only when one is selected
+  function updateSecondaryFields() {
+    var hasApiKey = apiKeyInput.value.trim() !== '';
+    secondaryFields.forEach(function(field) {
+      field.style.display = (hasApiKey && secondaryProviderSelect.value) ? '' : 'none';
+    });
   }
 
   // Function to toggle advanced fields visibility
@@ -127,6 +210,14 @@ document.addEventListener('DOMContentLoaded', function() {
   // Listen for API key changes
   apiKeyInput.addEventListener('input', toggleAdvancedFields);
 
+  // Listen for backup provider changes
+  secondaryProviderSelect.addEventListener('change', function() {
+    var defaults = providerDefaults[secondaryProviderSelect.value];
+    secondaryBaseUrlInput.value = defaults ? defaults.base_url : '';
+    secondaryModelInput.value = defaults ? defaults.model : '';
+    updateSecondaryFields();
+  });
+
   // Save button handler
   document.getElementById('save-button').addEventListener('click', function() {
     var settings = {
@@ -136,7 +227,18 @@ document.addEventListener('DOMContentLoaded', function() {
       base_url: baseUrlInput.value.trim(),
       model: modelInput.value.trim(),
       system_message: systemMessageInput.value.trim(),
-      web_search_enabled: webSearchCheckbox.checked.toString()
+      web_search_enabled: webSearchCheckbox.checked.toString(),
+      secondary_provider: secondaryProviderSelect.value,
+      secondary_api_key: secondaryProviderSelect.value ? secondaryApiKeyInput.value.trim() : '',
+      secondary_base_url: secondaryProviderSelect.value ? secondaryBaseUrlInput.value.trim() : '',
+      secondary_model: secondaryProviderSelect.value ? secondaryModelInput.value.trim() : '',
+      hedge_enabled: hedgeCheckbox.checked.toString(),
+      hedge_percentile: hedgePercentileInput.value.trim(),
+      power_saving: powerSavingSelect.value,
+      candidate_models: candidateModelsInput.value.trim(),
+      auto_model_quality: autoModelQualitySelect.value,
+      resume_wakeup: resumeWakeupCheckbox.checked.toString(),
+      log_level: logLevelSelect.value
     };
 
     // Send settings back to Pebble (works for both emulator and real hardware)
@@ -158,6 +260,17 @@ document.addEventListener('DOMContentLoaded', function() {
     modelInput.value = defaults.model;
     systemMessageInput.value = defaultSystemMessage;
     webSearchCheckbox.checked = false;
+    secondaryProviderSelect.value = '';
+    secondaryApiKeyInput.value = '';
+    secondaryBaseUrlInput.value = '';
+    secondaryModelInput.value = '';
+    hedgeCheckbox.checked = false;
+    hedgePercentileInput.value = '';
+    powerSavingSelect.value = 'auto';
+    candidateModelsInput.value = '';
+    autoModelQualitySelect.value = '';
+    resumeWakeupCheckbox.checked = false;
+    logLevelSelect.value = 'info';
 
     // Toggle advanced fields visibility
     toggleAdvancedFields();
@@ -170,7 +283,18 @@ document.addEventListener('DOMContentLoaded', function() {
       base_url: defaults.base_url,
       model: defaults.model,
       system_message: defaultSystemMessage,
-      web_search_enabled: 'false'
+      web_search_enabled: 'false',
+      secondary_provider: '',
+      secondary_api_key: '',
+      secondary_base_url: '',
+      secondary_model: '',
+      hedge_enabled: 'false',
+      hedge_percentile: '',
+      power_saving: 'auto',
+      candidate_models: '',
+      auto_model_quality: '',
+      resume_wakeup: 'false',
+      log_level: 'info'
     };
 
     var url = returnTo + encodeURIComponent(JSON.stringify(settings));
@@ -1,8 +1,35 @@
 #include "ai_spark.h"
-
-// Global state - PDC sequences loaded once
-static GDrawCommandSequence *s_small_sequence = NULL;
-static GDrawCommandSequence *s_large_sequence = NULL;
+#include "build_profile.h"
+#include "logging.h"
+#include "power_policy.h"
+#include "profiler.h"
+
+// Spark layers in use at once: the empty state spark and the footer spark
+#define AI_SPARK_POOL_SIZE 2
+
+#if AI_SPARK_ENABLED
+// PDC sequences, loaded on first use and released when no visible spark needs them.
+// B/W platforms get pre-recolored ~bw variants generated by the wscript build.
+typedef struct {
+  GDrawCommandSequence *sequence;
+  uint32_t resource_id;
+  int refs;
+} SparkSequence;
+
+static SparkSequence s_sequences[] = {
+  [AI_SPARK_SMALL] = { NULL, RESOURCE_ID_AI_S, 0 },
+  [AI_SPARK_LARGE] = { NULL, RESOURCE_ID_AI_L, 0 },
+};
+#define NUM_SEQUENCES (int)(sizeof(s_sequences) / sizeof(s_sequences[0]))
+
+// Frame timing used if a sequence failed to load
+#define LOADING_FRAME_DURATION 100
+#else
+// Lean profile: a pulsing dot drawn with primitives instead of the PDC spark
+#define LEAN_NUM_FRAMES 4
+#define LEAN_FRAME_DURATION 250
+static const uint8_t s_lean_radius_percent[LEAN_NUM_FRAMES] = { 40, 55, 70, 55 };
+#endif
 
 // Individual spark layer instance
 struct AISparkLayer {
@@ -11,68 +38,90 @@ struct AISparkLayer {
   int frame_index;
   bool is_animating;
   AISparkSize size;
+  bool is_visible;  // Visible sparks hold a reference to their sequence
+  bool in_use;
 };
 
+// Spark instances come from a fixed pool instead of the heap
+static AISparkLayer s_spark_pool[AI_SPARK_POOL_SIZE];
+
 // Forward declarations
 static void update_proc(Layer *layer, GContext *ctx);
 static void next_frame_handler(void *context);
-static GDrawCommandSequence* get_sequence_for_size(AISparkSize size);
+static int get_num_frames(AISparkSize size);
+static uint16_t get_frame_duration(AISparkSize size, int frame_index);
+static void draw_frame(GContext *ctx, GRect bounds, AISparkSize size, int frame_index);
 
-void ai_spark_init(void) {
-  // Load both PDC sequences
-  s_small_sequence = gdraw_command_sequence_create_with_resource(RESOURCE_ID_AI_S);
-  s_large_sequence = gdraw_command_sequence_create_with_resource(RESOURCE_ID_AI_L);
+static void acquire_sequence(AISparkSize size);
+static void release_sequence(AISparkSize size);
 
-  if (!s_small_sequence || !s_large_sequence) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to load AI spark sequences!");
+#if AI_SPARK_ENABLED
+static GDrawCommandSequence* get_sequence_for_size(AISparkSize size);
+#endif
+
+// Timer for the next frame, at the rate the power policy allows
+static void schedule_next_frame(AISparkLayer *spark) {
+  spark->timer = NULL;
+  if (power_policy_spark_frozen()) {
+    // Stay on the current frame until the power mode changes
     return;
   }
 
-#ifndef PBL_COLOR
-  // Override colors to black on B/W watches only
-  GDrawCommandSequence *sequences[] = {s_small_sequence, s_large_sequence};
-  for (int s = 0; s < 2; s++) {
-    GDrawCommandSequence *seq = sequences[s];
-    int num_frames = gdraw_command_sequence_get_num_frames(seq);
-
-    for (int f = 0; f < num_frames; f++) {
-      GDrawCommandFrame *frame = gdraw_command_sequence_get_frame_by_index(seq, f);
-      GDrawCommandList *command_list = gdraw_command_frame_get_command_list(frame);
-      uint32_t num_commands = gdraw_command_list_get_num_commands(command_list);
+  uint32_t duration = get_frame_duration(spark->size, spark->frame_index);
+  spark->timer = app_timer_register(power_policy_spark_frame_ms(duration), next_frame_handler, spark);
+}
 
-      for (uint32_t i = 0; i < num_commands; i++) {
-        GDrawCommand *command = gdraw_command_list_get_command(command_list, i);
-        gdraw_command_set_fill_color(command, GColorBlack);
+static void power_mode_changed(PowerMode mode) {
+  for (int i = 0; i < AI_SPARK_POOL_SIZE; i++) {
+    AISparkLayer *spark = &s_spark_pool[i];
+    if (spark->in_use && spark->is_animating) {
+      if (spark->timer) {
+        app_timer_cancel(spark->timer);
       }
+      schedule_next_frame(spark);
     }
   }
-#endif
+}
 
-  APP_LOG(APP_LOG_LEVEL_INFO, "AI spark sequences loaded successfully");
+void ai_spark_init(void) {
+  // Sequences are loaded lazily when the first spark that needs one is shown
+  power_policy_subscribe(power_mode_changed);
 }
 
 void ai_spark_deinit(void) {
-  if (s_small_sequence) {
-    gdraw_command_sequence_destroy(s_small_sequence);
-    s_small_sequence = NULL;
-  }
-  if (s_large_sequence) {
-    gdraw_command_sequence_destroy(s_large_sequence);
-    s_large_sequence = NULL;
+#if AI_SPARK_ENABLED
+  for (int i = 0; i < NUM_SEQUENCES; i++) {
+    if (s_sequences[i].sequence) {
+      gdraw_command_sequence_destroy(s_sequences[i].sequence);
+      s_sequences[i].sequence = NULL;
+    }
+    s_sequences[i].refs = 0;
   }
+#endif
 }
 
 AISparkLayer* ai_spark_layer_create(GRect frame, AISparkSize size) {
-  AISparkLayer *spark = malloc(sizeof(AISparkLayer));
+  AISparkLayer *spark = NULL;
+  for (int i = 0; i < AI_SPARK_POOL_SIZE; i++) {
+    if (!s_spark_pool[i].in_use) {
+      spark = &s_spark_pool[i];
+      break;
+    }
+  }
+
   if (!spark) {
+    LOG_ERROR("AI spark pool exhausted");
     return NULL;
   }
 
+  spark->in_use = true;
   spark->layer = layer_create_with_data(frame, sizeof(AISparkLayer*));
   spark->timer = NULL;
   spark->frame_index = 0;
   spark->is_animating = false;
   spark->size = size;
+  spark->is_visible = true;
+  acquire_sequence(size);
 
   layer_set_update_proc(spark->layer, update_proc);
   *((AISparkLayer**)layer_get_data(spark->layer)) = spark;
@@ -89,11 +138,16 @@ void ai_spark_layer_destroy(AISparkLayer *spark) {
     app_timer_cancel(spark->timer);
   }
 
+  if (spark->is_visible) {
+    release_sequence(spark->size);
+  }
+
   if (spark->layer) {
     layer_destroy(spark->layer);
   }
 
-  free(spark);
+  // Return the instance to the pool
+  *spark = (AISparkLayer){ 0 };
 }
 
 Layer* ai_spark_get_layer(AISparkLayer *spark) {
@@ -106,15 +160,14 @@ void ai_spark_start_animation(AISparkLayer *spark) {
   }
 
   spark->is_animating = true;
-  spark->frame_index = 0;
-
-  // Schedule first frame
-  GDrawCommandSequence *seq = get_sequence_for_size(spark->size);
-  GDrawCommandFrame *frame = gdraw_command_sequence_get_frame_by_index(seq, 0);
-  uint16_t duration = gdraw_command_frame_get_duration(frame);
+  if (power_policy_spark_frozen()) {
+    // Keep showing the static frame
+    return;
+  }
 
+  spark->frame_index = 0;
   layer_mark_dirty(spark->layer);
-  spark->timer = app_timer_register(duration, next_frame_handler, spark);
+  schedule_next_frame(spark);
 }
 
 void ai_spark_stop_animation(AISparkLayer *spark) {
@@ -137,10 +190,8 @@ void ai_spark_set_frame(AISparkLayer *spark, int frame_index) {
 
   ai_spark_stop_animation(spark);
 
-  GDrawCommandSequence *seq = get_sequence_for_size(spark->size);
-  int num_frames = gdraw_command_sequence_get_num_frames(seq);
-
-  spark->frame_index = frame_index % num_frames;
+  // Wrapped at draw time, since a hidden spark's sequence may not be loaded yet
+  spark->frame_index = frame_index;
   layer_mark_dirty(spark->layer);
 }
 
@@ -152,6 +203,11 @@ void ai_spark_set_size(AISparkLayer *spark, AISparkSize size) {
   bool was_animating = spark->is_animating;
   ai_spark_stop_animation(spark);
 
+  if (spark->is_visible) {
+    release_sequence(spark->size);
+    acquire_sequence(size);
+  }
+
   spark->size = size;
   layer_mark_dirty(spark->layer);
 
@@ -160,28 +216,85 @@ void ai_spark_set_size(AISparkLayer *spark, AISparkSize size) {
   }
 }
 
+void ai_spark_set_visible(AISparkLayer *spark, bool visible) {
+  if (!spark || spark->is_visible == visible) {
+    return;
+  }
+
+  spark->is_visible = visible;
+  layer_set_hidden(spark->layer, !visible);
+
+  if (visible) {
+    acquire_sequence(spark->size);
+  } else {
+    ai_spark_stop_animation(spark);
+    release_sequence(spark->size);
+  }
+}
+
 bool ai_spark_is_animating(AISparkLayer *spark) {
   return spark ? spark->is_animating : false;
 }
 
 // Private helper functions
 
+#if AI_SPARK_ENABLED
+
+static void acquire_sequence(AISparkSize size) {
+  SparkSequence *entry = &s_sequences[size];
+  if (entry->refs++ > 0) {
+    return;
+  }
+
+  entry->sequence = gdraw_command_sequence_create_with_resource(entry->resource_id);
+  if (!entry->sequence) {
+    LOG_ERROR("Failed to load AI spark sequence %d!", (int)size);
+  }
+}
+
+static void release_sequence(AISparkSize size) {
+  SparkSequence *entry = &s_sequences[size];
+  if (entry->refs == 0 || --entry->refs > 0) {
+    return;
+  }
+
+  if (entry->sequence) {
+    gdraw_command_sequence_destroy(entry->sequence);
+    entry->sequence = NULL;
+  }
+}
+
 static GDrawCommandSequence* get_sequence_for_size(AISparkSize size) {
-  return (size == AI_SPARK_SMALL) ? s_small_sequence : s_large_sequence;
+  return s_sequences[size].sequence;
 }
 
-static void update_proc(Layer *layer, GContext *ctx) {
-  AISparkLayer *spark = *((AISparkLayer**)layer_get_data(layer));
-  if (!spark) {
+static int get_num_frames(AISparkSize size) {
+  GDrawCommandSequence *seq = get_sequence_for_size(size);
+  return seq ? gdraw_command_sequence_get_num_frames(seq) : 1;
+}
+
+static uint16_t get_frame_duration(AISparkSize size, int frame_index) {
+  GDrawCommandSequence *seq = get_sequence_for_size(size);
+  if (!seq) {
+    return LOADING_FRAME_DURATION;
+  }
+
+  int num_frames = gdraw_command_sequence_get_num_frames(seq);
+  GDrawCommandFrame *frame = gdraw_command_sequence_get_frame_by_index(seq, frame_index % num_frames);
+  return gdraw_command_frame_get_duration(frame);
+}
+
+static void draw_frame(GContext *ctx, GRect bounds, AISparkSize size, int frame_index) {
+  GDrawCommandSequence *seq = get_sequence_for_size(size);
+  if (!seq) {
     return;
   }
 
-  GRect bounds = layer_get_bounds(layer);
-  GDrawCommandSequence *seq = get_sequence_for_size(spark->size);
   GSize seq_bounds = gdraw_command_sequence_get_bounds_size(seq);
 
-  // Get the current frame
-  GDrawCommandFrame *frame = gdraw_command_sequence_get_frame_by_index(seq, spark->frame_index);
+  // Get the current frame (the index may predate the sequence being loaded)
+  int num_frames = gdraw_command_sequence_get_num_frames(seq);
+  GDrawCommandFrame *frame = gdraw_command_sequence_get_frame_by_index(seq, frame_index % num_frames);
 
   // Draw centered in the layer
   if (frame) {
@@ -192,18 +305,53 @@ static void update_proc(Layer *layer, GContext *ctx) {
   }
 }
 
+#else
+
+static void acquire_sequence(AISparkSize size) {
+  // Nothing to load for the primitive spark
+}
+
+static void release_sequence(AISparkSize size) {
+}
+
+static int get_num_frames(AISparkSize size) {
+  return LEAN_NUM_FRAMES;
+}
+
+static uint16_t get_frame_duration(AISparkSize size, int frame_index) {
+  return LEAN_FRAME_DURATION;
+}
+
+static void draw_frame(GContext *ctx, GRect bounds, AISparkSize size, int frame_index) {
+  int max_radius = (bounds.size.w < bounds.size.h ? bounds.size.w : bounds.size.h) / 2;
+  int radius = max_radius * s_lean_radius_percent[frame_index % LEAN_NUM_FRAMES] / 100;
+
+  graphics_context_set_fill_color(ctx, GColorBlack);
+  graphics_fill_circle(ctx, GPoint(bounds.size.w / 2, bounds.size.h / 2), radius);
+}
+
+#endif
+
+static void update_proc(Layer *layer, GContext *ctx) {
+  AISparkLayer *spark = *((AISparkLayer**)layer_get_data(layer));
+  if (!spark) {
+    return;
+  }
+
+  PROFILE_BEGIN(PROFILE_SPARK_DRAW);
+  draw_frame(ctx, layer_get_bounds(layer), spark->size, spark->frame_index);
+  PROFILE_END(PROFILE_SPARK_DRAW);
+}
+
 static void next_frame_handler(void *context) {
   AISparkLayer *spark = (AISparkLayer*)context;
   if (!spark || !spark->is_animating) {
     return;
   }
 
-  GDrawCommandSequence *seq = get_sequence_for_size(spark->size);
-  int num_frames = gdraw_command_sequence_get_num_frames(seq);
-
   // Advance to next frame
   spark->frame_index++;
-  if (spark->frame_index >= num_frames) {
+  if (spark->frame_index >= get_num_frames(spark->size)) {
     spark->frame_index = 0;
   }
 
@@ -211,7 +359,5 @@ static void next_frame_handler(void *context) {
   layer_mark_dirty(spark->layer);
 
   // Schedule next frame
-  GDrawCommandFrame *frame = gdraw_command_sequence_get_frame_by_index(seq, spark->frame_index);
-  uint16_t duration = gdraw_command_frame_get_duration(frame);
-  spark->timer = app_timer_register(duration, next_frame_handler, spark);
+  schedule_next_frame(spark);
 }
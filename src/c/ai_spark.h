@@ -16,7 +16,8 @@ typedef enum {
 typedef struct AISparkLayer AISparkLayer;
 
 /**
- * Initialize the AI Spark system (loads PDC resources).
+ * Initialize the AI Spark system.
+ * PDC resources are loaded lazily while a spark that uses them is visible.
  * Call this once during app initialization.
  */
 void ai_spark_init(void);
@@ -74,6 +75,14 @@ void ai_spark_set_frame(AISparkLayer *spark, int frame_index);
  */
 void ai_spark_set_size(AISparkLayer *spark, AISparkSize size);
 
+/**
+ * Show or hide the spark. Hidden sparks stop animating and release their
+ * PDC sequence, so it is unloaded when no visible spark uses it.
+ * @param spark The spark layer
+ * @param visible true to show, false to hide
+ */
+void ai_spark_set_visible(AISparkLayer *spark, bool visible);
+
 /**
  * Check if the spark is currently animating.
  * @param spark The spark layer
@@ -1,121 +1,248 @@
 #include <pebble.h>
 #include "ai_spark.h"
+#include "build_profile.h"
 #include "chat_window.h"
+#include "conversation_menu.h"
+#include "logging.h"
+#include "offline_queue.h"
+#include "power_policy.h"
+#include "profiler.h"
+#include "resume_wakeup.h"
 #include "setup_window.h"
 
+// Persistent storage keys for the last readiness state reported by JS
+#define PERSIST_KEY_IS_READY 1
+#define PERSIST_KEY_PROVIDER_NAME 2
+
 static Window *s_chat_window;
+static Window *s_menu_window;
 static Window *s_setup_window;
-static bool s_is_ready = true;  // Assume ready initially, will be corrected by JS
+static bool s_is_ready = true;  // Loaded from persistent storage, corrected by JS
 static char s_provider_name[32] = "AI";  // Default provider name
 
+// Launch timing, logged once JS confirms or corrects the cached readiness state
+static time_t s_launch_s;
+static uint16_t s_launch_ms;
+static bool s_launch_logged;
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+// Only logged, not needed when info messages are compiled out
+static int ms_since_launch(void) {
+  time_t now_s;
+  uint16_t now_ms;
+  time_ms(&now_s, &now_ms);
+  return (int)(now_s - s_launch_s) * 1000 + (int)now_ms - (int)s_launch_ms;
+}
+#endif
+
+static void load_cached_state(void) {
+  if (persist_exists(PERSIST_KEY_IS_READY)) {
+    s_is_ready = persist_read_bool(PERSIST_KEY_IS_READY);
+  }
+
+  if (persist_exists(PERSIST_KEY_PROVIDER_NAME)) {
+    persist_read_string(PERSIST_KEY_PROVIDER_NAME, s_provider_name, sizeof(s_provider_name));
+  }
+}
+
+static void show_chat_window(bool animated);
+
+// A conversation was picked in the menu
+static void open_conversation(uint32_t conversation_id, int length) {
+  chat_window_open_conversation(conversation_id, length);
+  show_chat_window(true);
+}
+
+static void show_chat_window(bool animated) {
+  // Remove setup window if present
+  if (s_setup_window && window_stack_contains_window(s_setup_window)) {
+    window_stack_remove(s_setup_window, false);
+  }
+
+  // The conversation menu is under the chat, Back goes there
+  if (!s_menu_window) {
+    s_menu_window = conversation_menu_create(open_conversation);
+  }
+
+  if (!window_stack_contains_window(s_menu_window)) {
+    window_stack_push(s_menu_window, false);
+  }
+
+  // Create chat window if needed, its UI is built when it loads
+  if (!s_chat_window) {
+    s_chat_window = chat_window_create();
+  }
+
+  // Push chat window
+  if (!window_stack_contains_window(s_chat_window)) {
+    window_stack_push(s_chat_window, animated);
+  }
+}
+
+static void show_setup_window(bool animated) {
+  // Remove chat window and the menu under it if present
+  if (s_chat_window && window_stack_contains_window(s_chat_window)) {
+    window_stack_remove(s_chat_window, false);
+  }
+
+  if (s_menu_window && window_stack_contains_window(s_menu_window)) {
+    window_stack_remove(s_menu_window, false);
+  }
+
+  // Create setup window if needed
+  if (!s_setup_window) {
+    s_setup_window = setup_window_create();
+  }
+
+  // Push setup window
+  if (!window_stack_contains_window(s_setup_window)) {
+    window_stack_push(s_setup_window, animated);
+  }
+}
+
 static void inbox_received_callback(DictionaryIterator *iterator, void *context) {
-  // Check for PROVIDER_NAME message
+  PROFILE_BEGIN(PROFILE_INBOX_RECEIVED);
+
+  // Check for PROVIDER_NAME message, JS sends it on every launch so only act on changes
   Tuple *provider_name_tuple = dict_find(iterator, MESSAGE_KEY_PROVIDER_NAME);
-  if (provider_name_tuple) {
+  if (provider_name_tuple && strncmp(s_provider_name, provider_name_tuple->value->cstring, sizeof(s_provider_name) - 1) != 0) {
     snprintf(s_provider_name, sizeof(s_provider_name), "%s", provider_name_tuple->value->cstring);
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "Received PROVIDER_NAME: %s", s_provider_name);
+    LOG_DEBUG("Received PROVIDER_NAME: %s", s_provider_name);
+    persist_write_string(PERSIST_KEY_PROVIDER_NAME, s_provider_name);
 
     // Update windows with new provider name
     chat_window_set_provider_name(s_provider_name);
     setup_window_set_provider_name(s_provider_name);
   }
 
+  // Check for POWER_SAVING setting
+  Tuple *power_saving_tuple = dict_find(iterator, MESSAGE_KEY_POWER_SAVING);
+  if (power_saving_tuple) {
+    power_policy_set_saving(power_saving_tuple->value->int32);
+  }
+
+  // Check for RESUME_WAKEUP setting
+  Tuple *resume_wakeup_tuple = dict_find(iterator, MESSAGE_KEY_RESUME_WAKEUP);
+  if (resume_wakeup_tuple) {
+    resume_wakeup_set_enabled(resume_wakeup_tuple->value->int32 != 0);
+  }
+
+  // Check for PROVIDER_STATUS message (circuit breaker state: 0 closed, 1 half-open, 2 open)
+  Tuple *provider_status_tuple = dict_find(iterator, MESSAGE_KEY_PROVIDER_STATUS);
+  if (provider_status_tuple) {
+    int status = provider_status_tuple->value->int32;
+    LOG_DEBUG("Received PROVIDER_STATUS: %d", status);
+    chat_window_set_provider_available(status != 2);
+  }
+
   // Check for READY_STATUS message
   Tuple *ready_status_tuple = dict_find(iterator, MESSAGE_KEY_READY_STATUS);
   if (ready_status_tuple) {
     int status = ready_status_tuple->value->int32;
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "Received READY_STATUS: %d", status);
+    LOG_DEBUG("Received READY_STATUS: %d", status);
 
     bool new_ready_state = (status == 1);
 
-    // If status changed, update windows
+    if (!s_launch_logged) {
+      s_launch_logged = true;
+      LOG_INFO("Readiness confirmed %d ms after launch (cache %s)",
+               ms_since_launch(), s_is_ready == new_ready_state ? "hit" : "miss");
+    }
+
+    // If status changed, correct the cached state and switch windows
     if (s_is_ready != new_ready_state) {
       s_is_ready = new_ready_state;
+      persist_write_bool(PERSIST_KEY_IS_READY, s_is_ready);
 
       if (new_ready_state) {
-        // Need to show chat window
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "Transitioning to chat window");
-
-        // Remove setup window if present
-        if (s_setup_window && window_stack_contains_window(s_setup_window)) {
-          window_stack_remove(s_setup_window, false);
-        }
-
-        // Create chat window if needed
-        if (!s_chat_window) {
-          s_chat_window = chat_window_create();
-        }
-
-        // Push chat window
-        if (!window_stack_contains_window(s_chat_window)) {
-          window_stack_push(s_chat_window, true);
-        }
+        LOG_DEBUG("Transitioning to chat window");
+        show_chat_window(true);
       } else {
-        // Need to show setup window
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "Transitioning to setup window");
-
-        // Remove chat window if present
-        if (s_chat_window && window_stack_contains_window(s_chat_window)) {
-          window_stack_remove(s_chat_window, false);
-        }
-
-        // Create setup window if needed
-        if (!s_setup_window) {
-          s_setup_window = setup_window_create();
-        }
-
-        // Push setup window
-        if (!window_stack_contains_window(s_setup_window)) {
-          window_stack_push(s_setup_window, true);
-        }
+        LOG_DEBUG("Transitioning to setup window");
+        show_setup_window(true);
       }
     }
-
-    return;
   }
 
-  // Forward other messages to chat window handler
+  // Forward other messages to the chat window and menu handlers (JS may batch them with status keys)
   chat_window_handle_inbox(iterator);
+  conversation_menu_handle_inbox(iterator);
+
+  PROFILE_END(PROFILE_INBOX_RECEIVED);
 }
 
 static void inbox_dropped_callback(AppMessageResult reason, void *context) {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Message dropped: %d", (int)reason);
+  PROFILE_BEGIN(PROFILE_INBOX_DROPPED);
+  LOG_ERROR("Message dropped: %d", (int)reason);
+  PROFILE_END(PROFILE_INBOX_DROPPED);
 }
 
 static void outbox_failed_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context) {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox send failed: %d", (int)reason);
+  PROFILE_BEGIN(PROFILE_OUTBOX_FAILED);
+  LOG_ERROR("Outbox send failed: %d", (int)reason);
+  chat_window_handle_outbox_failed(iterator);
+  PROFILE_END(PROFILE_OUTBOX_FAILED);
 }
 
 static void outbox_sent_callback(DictionaryIterator *iterator, void *context) {
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "Outbox send success!");
+  PROFILE_BEGIN(PROFILE_OUTBOX_SENT);
+  LOG_DEBUG("Outbox send success!");
+  PROFILE_END(PROFILE_OUTBOX_SENT);
 }
 
 static void prv_init(void) {
+  time_ms(&s_launch_s, &s_launch_ms);
+
+  // Follow the battery before anything animates
+  power_policy_init();
+
   // Initialize AI spark system
   ai_spark_init();
 
+  // Questions that were still waiting for an answer when the app last closed
+  offline_queue_init();
+  resume_wakeup_init();
+
   // Initialize AppMessage
   app_message_register_inbox_received(inbox_received_callback);
   app_message_register_inbox_dropped(inbox_dropped_callback);
   app_message_register_outbox_failed(outbox_failed_callback);
   app_message_register_outbox_sent(outbox_sent_callback);
 
-  // Open AppMessage with large inbox (for history) and large outbox (for chunks)
-  app_message_open(4096, 4096);
+  // Open AppMessage with inbox (for responses) and outbox (for history) sized by the build profile
+  app_message_open(APP_MESSAGE_INBOX_SIZE, APP_MESSAGE_OUTBOX_SIZE);
+
+  // Show the window for the last known state right away, JS sends READY_STATUS to correct it
+  load_cached_state();
+  chat_window_set_provider_name(s_provider_name);
+  setup_window_set_provider_name(s_provider_name);
 
-  // Create and push chat window initially
-  // JS will send READY_STATUS=0 if not configured, which will replace with setup window
-  s_chat_window = chat_window_create();
-  window_stack_push(s_chat_window, true);
+  if (s_is_ready) {
+    show_chat_window(true);
+  } else {
+    show_setup_window(true);
+  }
+
+  LOG_INFO("First window pushed %d ms after launch", ms_since_launch());
 }
 
 static void prv_deinit(void) {
+  PROFILE_DUMP();
+
+  // Come back for questions that are still unanswered
+  resume_wakeup_schedule();
+
   // Destroy windows
   if (s_chat_window) {
     chat_window_destroy(s_chat_window);
     s_chat_window = NULL;
   }
 
+  if (s_menu_window) {
+    conversation_menu_destroy(s_menu_window);
+    s_menu_window = NULL;
+  }
+
   if (s_setup_window) {
     setup_window_destroy(s_setup_window);
     s_setup_window = NULL;
@@ -123,12 +250,13 @@ static void prv_deinit(void) {
 
   // Deinitialize AI spark system
   ai_spark_deinit();
+  power_policy_deinit();
 }
 
 int main(void) {
   prv_init();
 
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "Done initializing, pushed chat window: %p", s_chat_window);
+  LOG_DEBUG("Done initializing, ready: %d", s_is_ready);
 
   app_event_loop();
   prv_deinit();
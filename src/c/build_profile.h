@@ -0,0 +1,42 @@
+#pragma once
+#include <pebble.h>
+
+/**
+ * Build Profile
+ *
+ * Per-platform sizing of buffers and features. Aplite has about 24 KB of
+ * app heap, so it gets a lean profile: small AppMessage buffers, a shallow
+ * history and no PDC spark (draw commands aren't available there either).
+ */
+
+#if defined(PBL_PLATFORM_APLITE)
+
+#define PROFILE_LEAN 1
+
+// AppMessage buffers (JS sizes its messages to the inbox, see dispatch.js)
+#define APP_MESSAGE_INBOX_SIZE 1024
+#define APP_MESSAGE_OUTBOX_SIZE 1024
+
+// Upper bound on messages kept in history
+#define PROFILE_MAX_HISTORY 8
+
+// Heap kept free for everything that isn't history
+#define PROFILE_HEAP_RESERVE_BYTES 3072
+
+// Animated PDC spark
+#define AI_SPARK_ENABLED 0
+
+#else
+
+#define PROFILE_LEAN 0
+
+#define APP_MESSAGE_INBOX_SIZE 4096
+#define APP_MESSAGE_OUTBOX_SIZE 4096
+
+#define PROFILE_MAX_HISTORY 32
+
+#define PROFILE_HEAP_RESERVE_BYTES 6144
+
+#define AI_SPARK_ENABLED 1
+
+#endif
@@ -5,34 +5,29 @@
 #define SPARK_SIZE 25
 #define PADDING 10
 #define TEXT_FONT FONT_KEY_GOTHIC_14
+#define DISCLAIMER_TEXT_SIZE 64
 
 struct ChatFooter {
   Layer *layer;
   AISparkLayer *spark;
   TextLayer *text_layer;
-  char *disclaimer_text;
+  char disclaimer_text[DISCLAIMER_TEXT_SIZE];
+  int width;
   int height;
 };
 
-ChatFooter* chat_footer_create(int width, const char *provider_name) {
-  ChatFooter *footer = malloc(sizeof(ChatFooter));
-  if (!footer) {
-    return NULL;
-  }
-
-  // Create disclaimer text
+// Format the disclaimer and lay out the spark and text around it
+static void layout_footer(ChatFooter *footer, const char *provider_name, bool provider_available) {
   const char *name = provider_name ? provider_name : "AI";
-  size_t text_len = strlen(name) + 32;  // Room for " can make\nmistakes."
-  footer->disclaimer_text = malloc(text_len);
-  if (!footer->disclaimer_text) {
-    free(footer);
-    return NULL;
+  if (provider_available) {
+    snprintf(footer->disclaimer_text, sizeof(footer->disclaimer_text), "%s\ncan make\nmistakes.", name);
+  } else {
+    snprintf(footer->disclaimer_text, sizeof(footer->disclaimer_text), "%s\nis not\nresponding.", name);
   }
-  snprintf(footer->disclaimer_text, text_len, "%s\ncan make\nmistakes.", name);
 
   // Calculate text dimensions
   int text_x = PADDING + SPARK_SIZE + PADDING;
-  int text_width = width - text_x - PADDING;
+  int text_width = footer->width - text_x - PADDING;
 
   GFont font = fonts_get_system_font(TEXT_FONT);
   GSize text_size = graphics_text_layout_get_content_size(
@@ -47,28 +42,45 @@ ChatFooter* chat_footer_create(int width, const char *provider_name) {
   int content_height = text_size.h > SPARK_SIZE ? text_size.h : SPARK_SIZE;
   footer->height = content_height + PADDING;
 
-  // Create container layer
-  footer->layer = layer_create(GRect(0, 0, width, footer->height));
+  GRect frame = layer_get_frame(footer->layer);
+  frame.size = GSize(footer->width, footer->height);
+  layer_set_frame(footer->layer, frame);
 
-  // Create small Claude spark on the left (vertically centered in content area)
+  // Spark on the left, text on the right (both vertically centered in content area)
   int spark_y = (content_height - SPARK_SIZE) / 2;
-  footer->spark = ai_spark_layer_create(
-    GRect(PADDING, spark_y, SPARK_SIZE, SPARK_SIZE),
-    AI_SPARK_SMALL
-  );
-  ai_spark_set_frame(footer->spark, 3);  // Static on frame 4
-  layer_add_child(footer->layer, ai_spark_get_layer(footer->spark));
+  layer_set_frame(ai_spark_get_layer(footer->spark), GRect(PADDING, spark_y, SPARK_SIZE, SPARK_SIZE));
 
-  // Create disclaimer text on the right (vertically centered in content area)
   int text_y = (content_height - text_size.h) / 2;
-  footer->text_layer = text_layer_create(GRect(text_x, text_y, text_width, text_size.h));
+  layer_set_frame(text_layer_get_layer(footer->text_layer), GRect(text_x, text_y, text_width, text_size.h));
   text_layer_set_text(footer->text_layer, footer->disclaimer_text);
+}
+
+ChatFooter* chat_footer_create(int width, const char *provider_name, bool provider_available) {
+  ChatFooter *footer = malloc(sizeof(ChatFooter));
+  if (!footer) {
+    return NULL;
+  }
+
+  footer->width = width;
+
+  // Create container layer (sized by layout_footer)
+  footer->layer = layer_create(GRect(0, 0, width, 0));
+
+  // Create small Claude spark on the left
+  footer->spark = ai_spark_layer_create(GRect(PADDING, 0, SPARK_SIZE, SPARK_SIZE), AI_SPARK_SMALL);
+  ai_spark_set_frame(footer->spark, 3);  // Static on frame 4
+  layer_add_child(footer->layer, ai_spark_get_layer(footer->spark));
+
+  // Create disclaimer text on the right
+  footer->text_layer = text_layer_create(GRect(0, 0, 0, 0));
   text_layer_set_font(footer->text_layer, fonts_get_system_font(TEXT_FONT));
   text_layer_set_text_alignment(footer->text_layer, GTextAlignmentLeft);
   text_layer_set_text_color(footer->text_layer, GColorDarkGray);
   text_layer_set_background_color(footer->text_layer, GColorClear);
   layer_add_child(footer->layer, text_layer_get_layer(footer->text_layer));
 
+  layout_footer(footer, provider_name, provider_available);
+
   return footer;
 }
 
@@ -89,17 +101,31 @@ void chat_footer_destroy(ChatFooter *footer) {
     layer_destroy(footer->layer);
   }
 
-  if (footer->disclaimer_text) {
-    free(footer->disclaimer_text);
+  free(footer);
+}
+
+void chat_footer_set_provider(ChatFooter *footer, const char *provider_name, bool provider_available) {
+  if (!footer) {
+    return;
   }
 
-  free(footer);
+  layout_footer(footer, provider_name, provider_available);
+  layer_mark_dirty(footer->layer);
 }
 
 Layer* chat_footer_get_layer(ChatFooter *footer) {
   return footer ? footer->layer : NULL;
 }
 
+void chat_footer_set_visible(ChatFooter *footer, bool visible) {
+  if (!footer) {
+    return;
+  }
+
+  layer_set_hidden(footer->layer, !visible);
+  ai_spark_set_visible(footer->spark, visible);
+}
+
 void chat_footer_start_animation(ChatFooter *footer) {
   if (footer && footer->spark) {
     ai_spark_start_animation(footer->spark);
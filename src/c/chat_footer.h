@@ -14,9 +14,10 @@ typedef struct ChatFooter ChatFooter;
  * Create a new chat footer.
  * @param width Width of the footer (typically content area width)
  * @param provider_name Name of the AI provider to use in disclaimer
+ * @param provider_available false to say the provider is not responding instead
  * @return Pointer to the created footer
  */
-ChatFooter* chat_footer_create(int width, const char *provider_name);
+ChatFooter* chat_footer_create(int width, const char *provider_name, bool provider_available);
 
 /**
  * Destroy a chat footer and free its resources.
@@ -24,6 +25,14 @@ ChatFooter* chat_footer_create(int width, const char *provider_name);
  */
 void chat_footer_destroy(ChatFooter *footer);
 
+/**
+ * Update the disclaimer in place (re-lays out the footer, height may change).
+ * @param footer The chat footer
+ * @param provider_name Name of the AI provider to use in disclaimer
+ * @param provider_available false to say the provider is not responding instead
+ */
+void chat_footer_set_provider(ChatFooter *footer, const char *provider_name, bool provider_available);
+
 /**
  * Get the underlying Layer for adding to view hierarchy.
  * @param footer The chat footer
@@ -31,6 +40,13 @@ void chat_footer_destroy(ChatFooter *footer);
  */
 Layer* chat_footer_get_layer(ChatFooter *footer);
 
+/**
+ * Show or hide the footer. Hiding it also releases the spark's resources.
+ * @param footer The chat footer
+ * @param visible true to show, false to hide
+ */
+void chat_footer_set_visible(ChatFooter *footer, bool visible);
+
 /**
  * Start animating the Claude spark.
  * @param footer The chat footer
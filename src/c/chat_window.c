@@ -2,16 +2,65 @@
 #include "message_bubble.h"
 #include "chat_footer.h"
 #include "ai_spark.h"
+#include "build_profile.h"
+#include "memory_governor.h"
+#include "profiler.h"
+#include "power_policy.h"
+#include "offline_queue.h"
+#include "link_mode.h"
+#include "resume_wakeup.h"
+#include "logging.h"
 #include <string.h>
 
-#define MAX_MESSAGES 10
 #define SCROLL_OFFSET 60
-#define MESSAGE_BUFFER_SIZE 4096
-
-// Message data structure
+// Holding up or down this long jumps to the previous or next message
+#define JUMP_HOLD_MS 500
+
+// REQUEST_CHAT frame layout, must match decodeConversation() in conversation.js
+#define CHAT_FRAME_ROLE_USER 0
+#define CHAT_FRAME_ROLE_ASSISTANT 1
+#define CHAT_FRAME_ROLE_PAGED_ASSISTANT 2  // Payload starts with the 16-bit response id
+#define CHAT_FRAME_HEADER_SIZE 3  // Role byte and 16-bit length
+
+// Paged responses: at most this many pages of a response are kept in its text buffer
+#define RESIDENT_PAGES 2
+// Fetch the next (or previous) page once the bubble edge is this close to the view
+#define PAGE_PREFETCH_DISTANCE 120
+// A page request that got no answer is sent again after this long
+#define PAGE_REQUEST_TIMEOUT_S 3
+// Longest wait for the next message of an answer: the longest provider request
+// (MAX_TIMEOUT_MS in latency.js) and time for the answer or error to come through
+#define TURN_TIMEOUT_MS (60000 + 10000)
+// Number of older (or newer) messages fetched from the phone's log at a time
+#define HISTORY_BATCH_SIZE 3
+// A queued question that couldn't be sent is tried again after this long
+#define QUEUE_RETRY_DELAY_MS 5000
+// Messages out of view are measured in slices of about this long, so buttons and
+// animations aren't held up by a long history
+#define LAYOUT_SLICE_MS 25
+// Pause between layout slices
+#define LAYOUT_SLICE_INTERVAL_MS 10
+
+// Pending UI work, applied at most once per display frame (less often when saving power)
+typedef enum {
+  UI_DIRTY_CONTENT = 1 << 0,        // Message list needs a rebuild
+  UI_DIRTY_ACTION_BAR = 1 << 1,     // Action bar icons may have changed
+  UI_DIRTY_SCROLL_BOTTOM = 1 << 2,  // Scroll to the newest message after layout
+} UIDirtyFlags;
+
+// Message data structure (text buffers are sized by the memory governor)
 typedef struct {
-  char text[512];
+  char *text;
   bool is_user;
+  bool is_pending;  // Queued question that hasn't reached the phone yet
+  // Long responses stay on the phone and arrive in pages. response_id is 0
+  // when the whole text is resident.
+  uint16_t response_id;
+  uint8_t first_page;      // Index of the first page in text
+  uint8_t resident_pages;  // Number of pages in text
+  uint8_t total_pages;
+  uint16_t page_lengths[RESIDENT_PAGES];
+  int16_t height;  // Bubble height, 0 until measured (set back to 0 whenever text changes)
 } Message;
 
 // Global state for the chat window
@@ -24,36 +73,95 @@ static GBitmap *s_action_icon_dictation;
 static GBitmap *s_action_icon_up;
 static GBitmap *s_action_icon_down;
 static ChatFooter *s_footer;
+#if defined(PBL_MICROPHONE)
 static DictationSession *s_dictation_session;
+#endif
+
+// Icons currently shown on the action bar (to skip redundant updates)
+static const GBitmap *s_action_bar_icons[NUM_BUTTONS];
+
+// Frame-coalesced UI update state
+static uint8_t s_ui_dirty = 0;
+static AppTimer *s_ui_timer = NULL;
 
 // Empty state UI (shown when no messages)
 static AISparkLayer *s_empty_spark;
 static TextLayer *s_empty_text_layer;
 
 // Message storage (designed for dynamic updates)
-static Message s_messages[MAX_MESSAGES];
+static Message s_messages[MEMORY_GOVERNOR_MAX_CAPACITY];
 static int s_message_count = 0;
-
-// Current UI state (bubble instances)
-static MessageBubble *s_bubbles[MAX_MESSAGES];
+static int s_capacity = 0;
+static int s_text_size = 0;
+
+// The phone keeps the whole conversation log, the watch only a window of it:
+// s_messages[0] is message s_base_index of the log, which has s_log_length messages.
+// Messages before s_history_floor are no longer available on the phone.
+static uint32_t s_conversation_id = 0;
+static int s_base_index = 0;
+static int s_log_length = 0;
+static int s_history_floor = 0;
+
+// Conversation to show when the window loads (set from the conversation menu), 0
+// for a new one. Until one is picked the window resumes the queued conversation.
+static uint32_t s_open_id = 0;
+static int s_open_length = 0;
+static bool s_open_picked = false;
+
+// Last history fetch, to avoid asking twice while it's in flight
+static int s_history_request_index = -1;
+static time_t s_history_request_time = 0;
+
+// Bubble pool, created at window load and reused for whichever messages are shown
+static MessageBubble *s_bubbles[MEMORY_GOVERNOR_MAX_CAPACITY];
 static int s_bubble_count = 0;
 
 static int s_content_width = 0;
 
+// Scroll correction for text added or evicted above the view, applied on the next rebuild
+static int s_scroll_shift = 0;
+
+// Height index: s_message_tops[i] is the sum of the heights of the messages before
+// message i, s_message_tops[n] the bottom of the first n. Entries from
+// s_tops_valid_from on are stale, they're summed again when next used.
+static int s_message_tops[MEMORY_GOVERNOR_MAX_CAPACITY + 1];
+static int s_tops_valid_from = 1;
+
+// Measures the messages left out of the last layout slice
+static AppTimer *s_layout_timer = NULL;
+// The view stays at the newest message while layout completes
+static bool s_layout_follow_bottom = false;
+
+// Last page requested from JS, to avoid asking twice while it's in flight
+static uint16_t s_page_request_id = 0;
+static int s_page_request_page = -1;
+static time_t s_page_request_time = 0;
+
+// Retries sending the oldest queued question
+static AppTimer *s_flush_timer = NULL;
+
 // Chat state
 static bool s_waiting_for_response = false;
 static char s_provider_name[32] = "AI";
+static bool s_provider_available = true;
 
 // Forward declarations
 static void rebuild_scroll_content(void);
 static void update_action_bar(void);
+static void schedule_ui_update(uint8_t flags);
+#if defined(PBL_MICROPHONE)
 static void dictation_session_callback(DictationSession *session, DictationSessionStatus status, char *transcription, void *context);
+static void send_request_intent(void);
+#endif
 static void up_click_handler(ClickRecognizerRef recognizer, void *context);
 static void down_click_handler(ClickRecognizerRef recognizer, void *context);
-static void back_click_handler(ClickRecognizerRef recognizer, void *context);
 static void click_config_provider(void *context);
-static void send_chat_request(void);
+static void flush_queue(void);
 static void shift_messages(void);
+static void start_conversation(void);
+static void open_conversation(uint32_t conversation_id, int length);
+static bool resume_queued_turns(void);
+static void app_connection_handler(bool connected);
 static void add_assistant_message(const char *text);
 static void scroll_to_bottom(void);
 
@@ -92,8 +200,44 @@ static void window_load(Window *window) {
   s_content_layer = layer_create(GRect(0, 0, s_content_width, 100));
   scroll_layer_add_child(s_scroll_layer, s_content_layer);
 
+  // Size history to the free heap and allocate message text buffers
+  MemoryPlan plan = memory_governor_plan();
+  s_text_size = plan.text_size;
+  s_capacity = 0;
+  for (int i = 0; i < plan.capacity; i++) {
+    s_messages[i].text = malloc(s_text_size);
+    if (!s_messages[i].text) {
+      LOG_WARNING("Only allocated %d of %d messages", i, plan.capacity);
+      break;
+    }
+    s_messages[i].text[0] = '\0';
+    s_capacity++;
+  }
+
+  // Create bubble pool (hidden until a message is assigned to it)
+  for (int i = 0; i < s_capacity; i++) {
+    MessageBubble *bubble = message_bubble_create("", false, s_content_width);
+    if (!bubble) {
+      break;
+    }
+    s_bubbles[s_bubble_count++] = bubble;
+    layer_set_hidden(message_bubble_get_layer(bubble), true);
+    layer_add_child(s_content_layer, message_bubble_get_layer(bubble));
+  }
+
+#if MEASURE_CHECK_ENABLED
+  message_bubble_measure_check(s_content_width);
+#endif
+
   // Create footer
-  s_footer = chat_footer_create(s_content_width, s_provider_name);
+  s_footer = chat_footer_create(s_content_width, s_provider_name, s_provider_available);
+  layer_add_child(s_content_layer, chat_footer_get_layer(s_footer));
+  chat_footer_set_visible(s_footer, false);  // Shown by rebuild_scroll_content
+
+#if defined(PBL_MICROPHONE)
+  // Create the dictation session once and reuse it for every question
+  s_dictation_session = dictation_session_create(sizeof(char) * 256, dictation_session_callback, NULL);
+#endif
 
   // Create empty state UI (spark + text) - dynamically centered
   int spark_size = 60;
@@ -126,73 +270,119 @@ static void window_load(Window *window) {
   text_layer_set_text_color(s_empty_text_layer, GColorBlack);
   layer_add_child(window_layer, text_layer_get_layer(s_empty_text_layer));
 
+  // Open the conversation picked in the menu. At launch a new one is started,
+  // unless questions of the last one are still waiting to be answered.
+  if (s_open_id != 0) {
+    open_conversation(s_open_id, s_open_length);
+  } else if (s_open_picked || !resume_queued_turns()) {
+    start_conversation();
+  }
+
+  // Send queued questions as soon as the phone is reachable
+  connection_service_subscribe((ConnectionHandlers) {
+    .pebble_app_connection_handler = app_connection_handler,
+  });
+
   // Build the UI from message data
   rebuild_scroll_content();
+  flush_queue();
 }
 
-static void rebuild_scroll_content(void) {
-  // Check if we should show empty state or chat UI
-  if (s_message_count == 0) {
-    // Show empty state, hide scroll layer
-    layer_set_hidden(scroll_layer_get_layer(s_scroll_layer), true);
-    layer_set_hidden(ai_spark_get_layer(s_empty_spark), false);
-    layer_set_hidden(text_layer_get_layer(s_empty_text_layer), false);
+// Largest page that fits in a message buffer RESIDENT_PAGES times over
+static int page_bytes(void) {
+  return (s_text_size - 1) / RESIDENT_PAGES;
+}
 
-    // Update action bar for empty state
-    update_action_bar();
-    return;
-  } else {
-    // Show chat UI, hide empty state
-    layer_set_hidden(scroll_layer_get_layer(s_scroll_layer), false);
-    layer_set_hidden(ai_spark_get_layer(s_empty_spark), true);
-    layer_set_hidden(text_layer_get_layer(s_empty_text_layer), true);
+// Height of a message's bubble, estimated until it has been measured
+static int message_height(const Message *message) {
+  return message->height > 0 ? message->height : message_bubble_estimate_height(message->text, s_content_width);
+}
+
+// Number of messages with a bubble to show them
+static int laid_out_count(void) {
+  return s_message_count < s_bubble_count ? s_message_count : s_bubble_count;
+}
+
+// The tops of the messages after message from - 1 have moved
+static void invalidate_tops(int from) {
+  if (from < 1) {
+    from = 1;
+  }
+  if (from < s_tops_valid_from) {
+    s_tops_valid_from = from;
   }
+}
 
-  // Save current scroll position to restore after rebuild
-  GPoint saved_offset = scroll_layer_get_content_offset(s_scroll_layer);
+// Record a message's new height, 0 when its text changed and it needs measuring again
+static void set_message_height(Message *message, int height) {
+  message->height = height;
+  invalidate_tops(message - s_messages + 1);
+}
 
-  // Destroy old bubbles
-  for (int i = 0; i < s_bubble_count; i++) {
-    if (s_bubbles[i]) {
-      layer_remove_from_parent(message_bubble_get_layer(s_bubbles[i]));
-      message_bubble_destroy(s_bubbles[i]);
-      s_bubbles[i] = NULL;
+// Offset of message i from the top of the content (the bottom of the messages
+// before it). Only the stale part of the index is summed.
+static int message_top(int i) {
+  for (; s_tops_valid_from <= i; s_tops_valid_from++) {
+    int before = s_tops_valid_from - 1;
+    s_message_tops[s_tops_valid_from] = s_message_tops[before] + message_height(&s_messages[before]);
+  }
+  return s_message_tops[i];
+}
+
+// The message shown at content offset y (the nearest one when y is outside them all)
+static int message_at(int y) {
+  int low = 0;
+  int high = laid_out_count() - 1;
+  if (high < 0) {
+    return 0;
+  }
+
+  message_top(high);
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (s_message_tops[mid] <= y) {
+      low = mid;
+    } else {
+      high = mid - 1;
     }
   }
-  s_bubble_count = 0;
+  return low;
+}
 
-  // Remove footer from content layer
-  layer_remove_from_parent(chat_footer_get_layer(s_footer));
+// Measure message i with its bubble, unless its height is already known
+static void measure_message(int i) {
+  if (s_messages[i].height == 0) {
+    message_bubble_reset(s_bubbles[i], s_messages[i].text, s_messages[i].is_user);
+    set_message_height(&s_messages[i], message_bubble_get_height(s_bubbles[i]));
+  }
+}
 
-  // Create new bubbles from message data
-  int y_offset = 0;
-  int bubble_max_width = s_content_width;
+// Position the bubbles of the first count messages and the footer below them
+static void place_messages(int count) {
+  for (int i = 0; i < s_bubble_count; i++) {
+    Layer *bubble_layer = message_bubble_get_layer(s_bubbles[i]);
 
-  for (int i = 0; i < s_message_count; i++) {
-    MessageBubble *bubble = message_bubble_create(
-      s_messages[i].text,
-      s_messages[i].is_user,
-      bubble_max_width
-    );
-
-    if (bubble) {
-      s_bubbles[s_bubble_count++] = bubble;
-
-      // Position bubble
-      Layer *bubble_layer = message_bubble_get_layer(bubble);
-      GRect frame = layer_get_frame(bubble_layer);
-      frame.origin.x = 0;
-      frame.origin.y = y_offset;
-      layer_set_frame(bubble_layer, frame);
-      layer_add_child(s_content_layer, bubble_layer);
-
-      y_offset += message_bubble_get_height(bubble);
+    if (i >= count) {
+      layer_set_hidden(bubble_layer, true);
+      continue;
     }
+
+    int height = message_height(&s_messages[i]);
+    message_bubble_reset_sized(s_bubbles[i], s_messages[i].text, s_messages[i].is_user, height);
+    message_bubble_set_pending(s_bubbles[i], s_messages[i].is_pending);
+
+    // Position bubble
+    GRect frame = layer_get_frame(bubble_layer);
+    frame.origin.x = 0;
+    frame.origin.y = message_top(i);
+    layer_set_frame(bubble_layer, frame);
+    layer_set_hidden(bubble_layer, false);
   }
 
   // Add footer at the end
   // Add top padding only if last message is from user
-  bool last_is_user = (s_message_count > 0) && s_messages[s_message_count - 1].is_user;
+  int y_offset = message_top(count);
+  bool last_is_user = (count > 0) && s_messages[count - 1].is_user;
   if (last_is_user) {
     y_offset += 10;  // Add padding before footer
   }
@@ -203,7 +393,6 @@ static void rebuild_scroll_content(void) {
   footer_frame.origin.x = 0;
   footer_frame.origin.y = y_offset;
   layer_set_frame(footer_layer, footer_frame);
-  layer_add_child(s_content_layer, footer_layer);
 
   y_offset += footer_height;
 
@@ -214,29 +403,189 @@ static void rebuild_scroll_content(void) {
 
   // Update scroll layer content size
   scroll_layer_set_content_size(s_scroll_layer, GSize(s_content_width, y_offset));
+}
+
+static void layout_timer_callback(void *context);
+
+// Current time in milliseconds (wraps, only differences are meaningful)
+static uint32_t layout_time_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
 
-  // Restore previous scroll position (prevents jumping during rebuilds)
-  scroll_layer_set_content_offset(s_scroll_layer, saved_offset, false);
+// One slice of layout. The messages in view are measured right away, then as many
+// of the others as fit in LAYOUT_SLICE_MS, below the view first and then above it
+// (nearest first). Everything is placed with the heights known so far, the rest
+// are estimated and measured in the next slice. The message at the top of the view
+// keeps its place on screen as heights above it change.
+static void layout_slice(bool first_slice) {
+  PROFILE_BEGIN(PROFILE_LAYOUT_SLICE);
+  uint32_t start_ms = layout_time_ms();
+
+  int count = laid_out_count();
+  int view_height = layer_get_bounds(scroll_layer_get_layer(s_scroll_layer)).size.h;
+
+  // Corrected for pages that were added or evicted above the view
+  GPoint offset = scroll_layer_get_content_offset(s_scroll_layer);
+  int view_top = -(offset.y + s_scroll_shift);
+  s_scroll_shift = 0;
+
+  // The message at the top of the view, and how far into it the view starts
+  int anchor = message_at(view_top);
+  int anchor_offset = view_top - message_top(anchor);
+
+  // Messages in view, measured whatever it takes
+  int first = anchor;
+  int last = anchor - 1;
+  int covered = 0;
+  if (s_layout_follow_bottom) {
+    // Filled from the newest message up
+    first = count;
+    last = count - 1;
+    while (first > 0 && covered < view_height) {
+      measure_message(--first);
+      covered += s_messages[first].height;
+    }
+  } else {
+    covered = -anchor_offset;
+    while (last < count - 1 && covered < view_height) {
+      measure_message(++last);
+      covered += s_messages[last].height;
+    }
+  }
+
+  // The others while the slice lasts
+  for (int i = last + 1; i < count && layout_time_ms() - start_ms < LAYOUT_SLICE_MS; i++) {
+    measure_message(i);
+  }
+  for (int i = first - 1; i >= 0 && layout_time_ms() - start_ms < LAYOUT_SLICE_MS; i--) {
+    measure_message(i);
+  }
+
+  place_messages(count);
+
+  if (s_layout_follow_bottom && !first_slice) {
+    scroll_to_bottom();
+  } else if (count > 0) {
+    // Restore the scroll position (prevents jumping during rebuilds)
+    GPoint anchored = GPoint(0, -(message_top(anchor) + anchor_offset));
+    if (first_slice || anchored.y != offset.y) {
+      scroll_layer_set_content_offset(s_scroll_layer, anchored, false);
+    }
+  }
+
+  // Carry on with what's left
+  for (int i = 0; i < count; i++) {
+    if (s_messages[i].height == 0) {
+      s_layout_timer = app_timer_register(LAYOUT_SLICE_INTERVAL_MS, layout_timer_callback, NULL);
+      break;
+    }
+  }
+  PROFILE_END(PROFILE_LAYOUT_SLICE);
+}
+
+static void layout_timer_callback(void *context) {
+  s_layout_timer = NULL;
+  layout_slice(false);
+}
+
+static void rebuild_scroll_content(void) {
+  PROFILE_BEGIN(PROFILE_REBUILD_CONTENT);
+
+  // A new layout starts, heights measured by the last one are kept
+  if (s_layout_timer) {
+    app_timer_cancel(s_layout_timer);
+    s_layout_timer = NULL;
+  }
+
+  // Check if we should show empty state or chat UI
+  if (s_message_count == 0) {
+    // Show empty state, hide scroll layer. Hide first so only one spark
+    // sequence is resident at a time.
+    layer_set_hidden(scroll_layer_get_layer(s_scroll_layer), true);
+    chat_footer_set_visible(s_footer, false);
+    ai_spark_set_visible(s_empty_spark, true);
+    layer_set_hidden(text_layer_get_layer(s_empty_text_layer), false);
+
+    // Update action bar for empty state
+    update_action_bar();
+    PROFILE_END(PROFILE_REBUILD_CONTENT);
+    return;
+  } else {
+    // Show chat UI, hide empty state
+    ai_spark_set_visible(s_empty_spark, false);
+    layer_set_hidden(scroll_layer_get_layer(s_scroll_layer), false);
+    chat_footer_set_visible(s_footer, true);
+    layer_set_hidden(text_layer_get_layer(s_empty_text_layer), true);
+  }
+
+  layout_slice(true);
 
   // Update action bar for chat state
   update_action_bar();
+  PROFILE_END(PROFILE_REBUILD_CONTENT);
 }
 
-static void update_action_bar(void) {
-  // Clear all icons first
-  action_bar_layer_clear_icon(s_action_bar, BUTTON_ID_SELECT);
-  action_bar_layer_clear_icon(s_action_bar, BUTTON_ID_UP);
-  action_bar_layer_clear_icon(s_action_bar, BUTTON_ID_DOWN);
+static void set_action_bar_icon(ButtonId button, const GBitmap *icon) {
+  // Only touch the action bar when the icon actually changes
+  if (s_action_bar_icons[button] == icon) {
+    return;
+  }
+  s_action_bar_icons[button] = icon;
 
+  if (icon) {
+    action_bar_layer_set_icon(s_action_bar, button, icon);
+  } else {
+    action_bar_layer_clear_icon(s_action_bar, button);
+  }
+}
+
+static void update_action_bar(void) {
   // Show up/down arrows only if there are messages
-  if (s_message_count > 0) {
-    action_bar_layer_set_icon(s_action_bar, BUTTON_ID_UP, s_action_icon_up);
-    action_bar_layer_set_icon(s_action_bar, BUTTON_ID_DOWN, s_action_icon_down);
+  bool has_messages = s_message_count > 0;
+  set_action_bar_icon(BUTTON_ID_UP, has_messages ? s_action_icon_up : NULL);
+  set_action_bar_icon(BUTTON_ID_DOWN, has_messages ? s_action_icon_down : NULL);
+
+  // Show mic icon while there's room in the queue (and the watch has a microphone),
+  // questions asked while an answer is on its way are sent after it
+#if defined(PBL_MICROPHONE)
+  set_action_bar_icon(BUTTON_ID_SELECT, offline_queue_count() < OFFLINE_QUEUE_CAPACITY ? s_action_icon_dictation : NULL);
+#endif
+}
+
+static void ui_update_timer_callback(void *context) {
+  PROFILE_BEGIN(PROFILE_UI_UPDATE);
+  s_ui_timer = NULL;
+
+  uint8_t dirty = s_ui_dirty;
+  s_ui_dirty = 0;
+
+  // Layout keeps the newest message in view until it's done, unless the user scrolls
+  if (dirty & (UI_DIRTY_CONTENT | UI_DIRTY_SCROLL_BOTTOM)) {
+    s_layout_follow_bottom = (dirty & UI_DIRTY_SCROLL_BOTTOM) != 0;
   }
 
-  // Show mic icon only if not waiting for response
-  if (!s_waiting_for_response) {
-    action_bar_layer_set_icon(s_action_bar, BUTTON_ID_SELECT, s_action_icon_dictation);
+  // Rebuilding the content also refreshes the action bar
+  if (dirty & UI_DIRTY_CONTENT) {
+    rebuild_scroll_content();
+  } else if (dirty & UI_DIRTY_ACTION_BAR) {
+    update_action_bar();
+  }
+
+  if (dirty & UI_DIRTY_SCROLL_BOTTOM) {
+    scroll_to_bottom();
+  }
+  PROFILE_END(PROFILE_UI_UPDATE);
+}
+
+static void schedule_ui_update(uint8_t flags) {
+  // Record the change, bursts of updates within one frame are applied together
+  s_ui_dirty |= flags;
+
+  if (!s_ui_timer && s_window && window_is_loaded(s_window)) {
+    s_ui_timer = app_timer_register(power_policy_ui_interval_ms(), ui_update_timer_callback, NULL);
   }
 }
 
@@ -245,43 +594,415 @@ static void shift_messages(void) {
     return;
   }
 
-  // Shift all messages one position forward (removing the first/oldest message)
+  // Shift all messages one position forward (removing the first/oldest message),
+  // moving the oldest text buffer to the end so it can be reused
+  char *oldest_text = s_messages[0].text;
   for (int i = 0; i < s_message_count - 1; i++) {
     s_messages[i] = s_messages[i + 1];
   }
+  s_messages[s_message_count - 1].text = oldest_text;
+  invalidate_tops(1);
 
   // Decrement count to free up the last slot
   s_message_count--;
+  s_base_index++;
 }
 
-static void add_user_message(const char *text) {
-  if (s_message_count >= MAX_MESSAGES) {
+// Make room at the front of the window for an older message, evicting the
+// newest one if the window is full. Returns the new first slot.
+static Message* unshift_message(void) {
+  if (s_message_count >= s_capacity) {
+    s_message_count--;
+  }
+
+  // The buffer of the first unused slot moves to the front
+  char *free_text = s_messages[s_message_count].text;
+  for (int i = s_message_count; i > 0; i--) {
+    s_messages[i] = s_messages[i - 1];
+  }
+  s_messages[0].text = free_text;
+  invalidate_tops(1);
+
+  s_message_count++;
+  s_base_index--;
+  return &s_messages[0];
+}
+
+// The window is at the end of the log, new messages can be added to it
+static bool window_at_log_end(void) {
+  return s_base_index + s_message_count >= s_log_length;
+}
+
+static void start_conversation(void) {
+  // Any id unlike the previous one works, JS starts a new log for it
+  uint32_t id = (uint32_t)time(NULL);
+  s_conversation_id = (id == s_conversation_id) ? id + 1 : id;
+
+  s_message_count = 0;
+  s_base_index = 0;
+  s_log_length = 0;
+  s_history_floor = 0;
+  s_history_request_index = -1;
+
+  // Questions of the previous conversation are dropped with it
+  offline_queue_clear();
+}
+
+static void shrink_history(int capacity) {
+  // Evict the oldest messages that no longer fit, scrolling up by their height to
+  // stay in place
+  while (s_message_count > capacity) {
+    s_scroll_shift += message_height(&s_messages[0]);
+    shift_messages();
+  }
+
+  // The bubbles may still show text from the buffers about to be freed, lay them out
+  // again with the messages that are left first
+  rebuild_scroll_content();
+
+  // Give back the text buffers and bubbles of the slots past the new capacity
+  for (int i = capacity; i < s_capacity; i++) {
+    free(s_messages[i].text);
+    s_messages[i].text = NULL;
+  }
+
+  for (int i = capacity; i < s_bubble_count; i++) {
+    message_bubble_destroy(s_bubbles[i]);
+    s_bubbles[i] = NULL;
+  }
+
+  if (s_bubble_count > capacity) {
+    s_bubble_count = capacity;
+  }
+  s_capacity = capacity;
+}
+
+static bool make_room_for_message(void) {
+  if (s_capacity == 0) {
+    // Message storage couldn't be allocated at all
+    return false;
+  }
+
+  // Give memory back before it runs out
+  int capacity = memory_governor_check(s_capacity);
+  if (capacity < s_capacity) {
+    shrink_history(capacity);
+  }
+
+  if (s_message_count >= s_capacity) {
     // Message array is full, shift to make room
     shift_messages();
   }
 
-  // Add the new message
-  snprintf(s_messages[s_message_count].text, sizeof(s_messages[s_message_count].text), "%s", text);
-  s_messages[s_message_count].is_user = true;
+  return true;
+}
+
+// Add a message to the log at window position, moving the messages after it
+// down. Returns NULL if it can't be shown: storage is unavailable, or the
+// position is outside the window (the phone's log still has it).
+static Message* insert_message(int position) {
+  s_log_length++;
+
+  int count_before = s_message_count;
+  if (position < 0 || position > s_message_count || !make_room_for_message()) {
+    return NULL;
+  }
+
+  // Account for the oldest messages evicted to make room
+  position -= count_before - s_message_count;
+  if (position < 0) {
+    position = 0;
+  }
+
+  char *free_text = s_messages[s_message_count].text;
+  for (int i = s_message_count; i > position; i--) {
+    s_messages[i] = s_messages[i - 1];
+  }
+
+  Message *message = &s_messages[position];
+  message->text = free_text;
+  message->text[0] = '\0';
+  message->is_pending = false;
+  message->response_id = 0;
+  set_message_height(message, 0);
   s_message_count++;
+  return message;
+}
+
+// Window position of a queued question
+static int queued_position(int queue_position) {
+  return offline_queue_first_index() + queue_position - s_base_index;
+}
+
+// Where the answer to the oldest queued question goes: right after it, ahead
+// of the questions queued behind it
+static int reply_position(void) {
+  return offline_queue_count() > 0 ? queued_position(0) + 1 : s_log_length - s_base_index;
+}
+
+// Put the queued question at log index back at the end of the window, the
+// phone doesn't have it to send. Returns false if index isn't queued.
+static bool restore_queued_turn(int index) {
+  QueuedTurn turn;
+  int position = index - offline_queue_first_index();
+  if (index != s_base_index + s_message_count || s_capacity == 0 || !offline_queue_peek(position, &turn)) {
+    return false;
+  }
+
+  if (s_message_count >= s_capacity) {
+    // The oldest message is above the view, scroll up by its height to stay in place
+    s_scroll_shift += message_height(&s_messages[0]);
+    shift_messages();
+  }
+
+  Message *message = &s_messages[s_message_count++];
+  snprintf(message->text, s_text_size, "%s", turn.text);
+  message->is_user = true;
+  message->is_pending = !(position == 0 && s_waiting_for_response);
+  message->response_id = 0;
+  set_message_height(message, 0);
+
+  schedule_ui_update(UI_DIRTY_CONTENT);
+  return true;
+}
+
+static bool resume_queued_turns(void) {
+  if (offline_queue_count() == 0) {
+    return false;
+  }
+
+  // Continue the conversation the questions belong to, the phone has the rest of it
+  s_conversation_id = offline_queue_conversation_id();
+  s_base_index = offline_queue_first_index();
+  s_log_length = s_base_index + offline_queue_count();
+  s_message_count = 0;
+  s_history_floor = 0;
+  s_history_request_index = -1;
+
+  while (s_message_count < s_capacity && restore_queued_turn(s_base_index + s_message_count)) {
+  }
+
+  LOG_INFO("Resumed conversation with %d queued questions", offline_queue_count());
+  return true;
+}
+
+// Length of the longest prefix of text that fits in max_len bytes without splitting a UTF-8 character
+static size_t utf8_prefix_length(const char *text, size_t max_len) {
+  size_t len = strlen(text);
+  if (len <= max_len) {
+    return len;
+  }
+
+  len = max_len;
+  while (len > 0 && ((uint8_t)text[len] & 0xC0) == 0x80) {
+    len--;
+  }
+  return len;
+}
+
+#if defined(PBL_MICROPHONE)
+static void add_user_message(const char *text) {
+  if (!window_at_log_end()) {
+    // Scrolled back through history, continue the conversation at its end, after
+    // the questions still queued
+    s_message_count = 0;
+    s_base_index = offline_queue_count() > 0 ? offline_queue_first_index() : s_log_length;
+    while (restore_queued_turn(s_base_index + s_message_count)) {
+    }
+    schedule_ui_update(UI_DIRTY_SCROLL_BOTTOM);
+  }
+
+  // Queue the question first, it's sent from the queue once the phone is reachable
+  size_t len = utf8_prefix_length(text, OFFLINE_QUEUE_TEXT_SIZE - 1);
+  if (!offline_queue_push(s_conversation_id, s_log_length, text, len)) {
+    vibes_short_pulse();
+    return;
+  }
+
+  Message *message = insert_message(s_message_count);
+  if (!message) {
+    return;
+  }
+
+  // Add the new message
+  snprintf(message->text, s_text_size, "%.*s", (int)len, text);
+  message->is_user = true;
+  message->is_pending = true;
 
   // Rebuild the UI to show the new message
-  rebuild_scroll_content();
+  schedule_ui_update(UI_DIRTY_CONTENT);
 }
+#endif
 
 static void add_assistant_message(const char *text) {
-  if (s_message_count >= MAX_MESSAGES) {
-    // Message array is full, shift to make room
-    shift_messages();
+  Message *message = insert_message(reply_position());
+  if (!message) {
+    return;
   }
 
   // Add empty or initial assistant message
-  snprintf(s_messages[s_message_count].text, sizeof(s_messages[s_message_count].text), "%s", text);
-  s_messages[s_message_count].is_user = false;
-  s_message_count++;
+  snprintf(message->text, s_text_size, "%s", text);
+  message->is_user = false;
 
   // Rebuild UI
-  rebuild_scroll_content();
+  schedule_ui_update(UI_DIRTY_CONTENT);
+}
+
+static Message* find_response(uint16_t response_id) {
+  if (response_id == 0) {
+    return NULL;
+  }
+
+  for (int i = 0; i < s_message_count; i++) {
+    if (s_messages[i].response_id == response_id) {
+      return &s_messages[i];
+    }
+  }
+  return NULL;
+}
+
+// Append a page to a paged message, evicting its first page if the window is full
+static void append_page(Message *message, const char *text, size_t len) {
+  if (message->resident_pages == RESIDENT_PAGES) {
+    int height_before = message_height(message);
+
+    size_t evicted = message->page_lengths[0];
+    memmove(message->text, message->text + evicted, strlen(message->text) - evicted + 1);
+    for (int i = 1; i < RESIDENT_PAGES; i++) {
+      message->page_lengths[i - 1] = message->page_lengths[i];
+    }
+    message->first_page++;
+    message->resident_pages--;
+
+    // The evicted text was above the view, scroll up by as much to stay in place
+    s_scroll_shift += height_before - message_bubble_measure_height(message->text, s_content_width);
+  }
+
+  size_t current = strlen(message->text);
+  memcpy(message->text + current, text, len);
+  message->text[current + len] = '\0';
+  message->page_lengths[message->resident_pages++] = len;
+  set_message_height(message, 0);
+}
+
+// Prepend a page to a paged message, evicting its last page if the window is full
+static void prepend_page(Message *message, const char *text, size_t len) {
+  if (message->resident_pages == RESIDENT_PAGES) {
+    size_t current = strlen(message->text);
+    message->text[current - message->page_lengths[RESIDENT_PAGES - 1]] = '\0';
+    message->resident_pages--;
+  }
+
+  int height_before = message_bubble_measure_height(message->text, s_content_width);
+
+  size_t current = strlen(message->text);
+  memmove(message->text + len, message->text, current + 1);
+  memcpy(message->text, text, len);
+  for (int i = message->resident_pages; i > 0; i--) {
+    message->page_lengths[i] = message->page_lengths[i - 1];
+  }
+  message->page_lengths[0] = len;
+  message->first_page--;
+  message->resident_pages++;
+
+  // The new text is above the view, scroll down by as much to stay in place
+  set_message_height(message, message_bubble_measure_height(message->text, s_content_width));
+  s_scroll_shift -= message->height - height_before;
+}
+
+// The page requested last has arrived, or JS doesn't have it
+static void end_page_request(void) {
+  s_page_request_page = -1;
+  PROFILE_SPAN_END(PROFILE_PAGE_LATENCY);
+
+  // A turn in flight keeps the link fast until its answer is in
+  if (!s_waiting_for_response) {
+    link_mode_release();
+  }
+}
+
+static void receive_response_page(uint16_t response_id, int page, int total_pages, const char *text) {
+  // Pages are cut to fit the buffer in case JS was told a different page size
+  size_t len = utf8_prefix_length(text, page_bytes());
+
+  if (response_id == s_page_request_id && page == s_page_request_page) {
+    end_page_request();
+  }
+
+  Message *message = find_response(response_id);
+  if (!message) {
+    // First page of a new response, later pages of evicted messages are stale
+    if (page != 0) {
+      return;
+    }
+
+    message = insert_message(reply_position());
+    if (!message) {
+      return;
+    }
+
+    message->is_user = false;
+    message->response_id = response_id;
+    message->first_page = 0;
+    message->resident_pages = 0;
+    append_page(message, text, len);
+  } else if (page == message->first_page + message->resident_pages) {
+    append_page(message, text, len);
+  } else if (page == message->first_page - 1) {
+    prepend_page(message, text, len);
+  } else {
+    LOG_DEBUG("Ignoring stale page %d of response %d", page, (int)response_id);
+    return;
+  }
+
+  message->total_pages = total_pages;
+  schedule_ui_update(UI_DIRTY_CONTENT);
+}
+
+static void request_page(const Message *message, int page) {
+  time_t now = time(NULL);
+  if (message->response_id == s_page_request_id && page == s_page_request_page &&
+      now - s_page_request_time < PAGE_REQUEST_TIMEOUT_S) {
+    return;
+  }
+
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return;
+  }
+
+  dict_write_uint16(iter, MESSAGE_KEY_RESPONSE_ID, message->response_id);
+  dict_write_uint8(iter, MESSAGE_KEY_REQUEST_PAGE, page);
+  if (app_message_outbox_send() == APP_MSG_OK) {
+    LOG_DEBUG("Requested page %d of response %d", page, (int)message->response_id);
+    PROFILE_SPAN_BEGIN(PROFILE_PAGE_LATENCY);
+    link_mode_hold(PAGE_REQUEST_TIMEOUT_S * 1000);
+    s_page_request_id = message->response_id;
+    s_page_request_page = page;
+    s_page_request_time = now;
+  }
+}
+
+// Fetch pages of paged messages whose resident text ends (or starts) close to the view
+static void request_pages_near(int view_top) {
+  int view_bottom = view_top + layer_get_bounds(scroll_layer_get_layer(s_scroll_layer)).size.h;
+  int last = message_at(view_bottom);
+
+  for (int i = message_at(view_top); i <= last && i < laid_out_count(); i++) {
+    const Message *message = &s_messages[i];
+    if (message->response_id == 0) {
+      continue;
+    }
+
+    int top = message_top(i);
+    int bottom = message_top(i + 1);
+    int next_page = message->first_page + message->resident_pages;
+    if (next_page < message->total_pages && bottom - view_bottom < PAGE_PREFETCH_DISTANCE) {
+      request_page(message, next_page);
+    } else if (message->first_page > 0 && view_top - top < PAGE_PREFETCH_DISTANCE) {
+      request_page(message, message->first_page - 1);
+    }
+  }
 }
 
 static void scroll_to_bottom(void) {
@@ -296,45 +1017,192 @@ static void scroll_to_bottom(void) {
   scroll_layer_set_content_offset(s_scroll_layer, GPoint(0, -max_offset), true);
 }
 
-static void send_chat_request(void) {
-  // Encode all messages into format: "[U]msg1[A]msg2[U]msg3..."
-  static char encoded_buffer[MESSAGE_BUFFER_SIZE];
-  encoded_buffer[0] = '\0';
+// Paged messages are sent with their response id so JS can use the full text
+static bool is_paged(const Message *message) {
+  return message->response_id != 0 && message->total_pages > 1;
+}
 
-  for (int i = 0; i < s_message_count; i++) {
-    const char *prefix = s_messages[i].is_user ? "[U]" : "[A]";
-    size_t current_len = strlen(encoded_buffer);
-    size_t available = MESSAGE_BUFFER_SIZE - current_len - 1;
+static size_t frame_overhead(const Message *message) {
+  return CHAT_FRAME_HEADER_SIZE + (is_paged(message) ? sizeof(uint16_t) : 0);
+}
+
+// Ask JS to answer the question at window position last, sending the conversation up to it
+static bool send_chat_request(int last, uint32_t turn_id) {
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if (result != APP_MSG_OK) {
+    LOG_ERROR("Failed to begin outbox: %d", (int)result);
+    return false;
+  }
 
-    // Add prefix
-    strncat(encoded_buffer, prefix, available);
-    current_len = strlen(encoded_buffer);
-    available = MESSAGE_BUFFER_SIZE - current_len - 1;
+  // Tell JS how large the pages of a long response can be
+  dict_write_uint16(iter, MESSAGE_KEY_PAGE_BYTES, page_bytes());
+  dict_write_uint32(iter, MESSAGE_KEY_CONVERSATION_ID, s_conversation_id);
+  dict_write_uint32(iter, MESSAGE_KEY_TURN_ID, turn_id);
+
+  // The conversation is written as one byte array tuple straight into the outbox, so the
+  // space left after the BASE_INDEX tuple and its tuple header is the budget
+  size_t capacity = (const uint8_t *)iter->end - (const uint8_t *)iter->cursor -
+                    2 * sizeof(Tuple) - sizeof(uint32_t);
+
+  // Measure each message once, keeping the newest ones that fit. The newest message is
+  // truncated if it doesn't fit on its own.
+  uint16_t lengths[MEMORY_GOVERNOR_MAX_CAPACITY];
+  size_t total = 0;
+  int end = last + 1;
+  int first = end;
+  while (first > 0 && total + frame_overhead(&s_messages[first - 1]) < capacity) {
+    const Message *message = &s_messages[first - 1];
+    size_t available = capacity - total - frame_overhead(message);
+    size_t len = utf8_prefix_length(message->text, available);
+    if (len < strlen(message->text) && first < end) {
+      break;
+    }
 
-    // Add message text
-    strncat(encoded_buffer, s_messages[i].text, available);
+    first--;
+    lengths[first] = len;
+    total += frame_overhead(message) + len;
   }
 
-  // Send via AppMessage
-  DictionaryIterator *iter;
-  AppMessageResult result = app_message_outbox_begin(&iter);
+  // The conversation sent to the provider has to start with a user turn
+  while (first < last && !s_messages[first].is_user) {
+    total -= frame_overhead(&s_messages[first]) + lengths[first];
+    first++;
+  }
 
-  if (result == APP_MSG_OK) {
-    dict_write_cstring(iter, MESSAGE_KEY_REQUEST_CHAT, encoded_buffer);
-    result = app_message_outbox_send();
+  // Log index of the first message sent, JS merges the window into its log from there
+  dict_write_uint32(iter, MESSAGE_KEY_BASE_INDEX, s_base_index + first);
 
-    if (result == APP_MSG_OK) {
-      APP_LOG(APP_LOG_LEVEL_DEBUG, "Sent REQUEST_CHAT: %d bytes", (int)strlen(encoded_buffer));
-      s_waiting_for_response = true;
-      chat_window_set_footer_animating(true);
+  // The tuple is added empty, then its value is written in place and it's grown to fit
+  Tuple *tuple = iter->cursor;
+  dict_write_data(iter, MESSAGE_KEY_REQUEST_CHAT, (const uint8_t *)"", 0);
 
-      // Update action bar to hide mic while waiting
-      update_action_bar();
+  // Frames: role byte, little-endian 16-bit length, then the text without a terminator.
+  // Paged messages carry their response id ahead of the resident text.
+  uint8_t *out = tuple->value->data;
+  for (int i = first; i < end; i++) {
+    const Message *message = &s_messages[i];
+    size_t payload = frame_overhead(message) - CHAT_FRAME_HEADER_SIZE + lengths[i];
+
+    if (message->is_user) {
+      *out++ = CHAT_FRAME_ROLE_USER;
     } else {
-      APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to send REQUEST_CHAT: %d", (int)result);
+      *out++ = is_paged(message) ? CHAT_FRAME_ROLE_PAGED_ASSISTANT : CHAT_FRAME_ROLE_ASSISTANT;
+    }
+    *out++ = payload & 0xFF;
+    *out++ = payload >> 8;
+    if (is_paged(message)) {
+      *out++ = message->response_id & 0xFF;
+      *out++ = message->response_id >> 8;
     }
+    memcpy(out, message->text, lengths[i]);
+    out += lengths[i];
+  }
+
+  tuple->length = total;
+  iter->cursor = (Tuple *)out;
+  dict_write_end(iter);
+
+  if (first > 0) {
+    LOG_WARNING("Left %d old messages out of REQUEST_CHAT", first);
+  }
+
+  result = app_message_outbox_send();
+  if (result != APP_MSG_OK) {
+    LOG_ERROR("Failed to send REQUEST_CHAT: %d", (int)result);
+    return false;
+  }
+
+  LOG_DEBUG("Sent REQUEST_CHAT: %d bytes", (int)total);
+  PROFILE_SPAN_BEGIN(PROFILE_TURN_LATENCY);
+
+  // Keep round trips short until the answer is in
+  link_mode_hold(TURN_TIMEOUT_MS);
+  s_waiting_for_response = true;
+  s_messages[last].is_pending = false;
+  chat_window_set_footer_animating(true);
+
+  // Show the question as sent, and hide the mic while waiting
+  schedule_ui_update(UI_DIRTY_CONTENT);
+  return true;
+}
+
+static void flush_timer_callback(void *context) {
+  s_flush_timer = NULL;
+  flush_queue();
+}
+
+static void schedule_flush(uint32_t delay_ms) {
+  if (s_flush_timer) {
+    app_timer_reschedule(s_flush_timer, delay_ms);
   } else {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to begin outbox: %d", (int)result);
+    s_flush_timer = app_timer_register(delay_ms, flush_timer_callback, NULL);
+  }
+}
+
+// Stop waiting for the answer to the question in flight and show it as queued again
+static void requeue_in_flight(void) {
+  s_waiting_for_response = false;
+  link_mode_release();
+
+  int position = queued_position(0);
+  if (position >= 0 && position < s_message_count) {
+    s_messages[position].is_pending = true;
+  }
+
+  chat_window_set_footer_animating(false);
+  schedule_ui_update(UI_DIRTY_CONTENT);
+}
+
+// Send the oldest queued question, one at a time and in order
+static void flush_queue(void) {
+  if (s_waiting_for_response || offline_queue_count() == 0) {
+    return;
+  }
+
+  if (!connection_service_peek_pebble_app_connection()) {
+    // Sent from app_connection_handler() once the phone is back
+    LOG_DEBUG("Phone unreachable, %d questions queued", offline_queue_count());
+    return;
+  }
+
+  int position = queued_position(0);
+  if (position < 0 || position >= s_message_count) {
+    // Scrolled back through history, sent when the window gets back to the end
+    return;
+  }
+
+  QueuedTurn turn;
+  if (offline_queue_peek(0, &turn) && !send_chat_request(position, turn.turn_id)) {
+    schedule_flush(QUEUE_RETRY_DELAY_MS);
+  }
+}
+
+static void app_connection_handler(bool connected) {
+  LOG_INFO("Phone %s", connected ? "connected" : "disconnected");
+
+  if (connected) {
+    flush_queue();
+  } else if (s_waiting_for_response) {
+    // The request may not have made it, it's sent again on reconnect (JS answers it only once)
+    requeue_in_flight();
+  }
+}
+
+#if defined(PBL_MICROPHONE)
+static void send_request_intent(void) {
+  // Let JS warm up the provider connection while the user is dictating
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+
+  if (result == APP_MSG_OK) {
+    dict_write_uint8(iter, MESSAGE_KEY_REQUEST_INTENT, 1);
+    result = app_message_outbox_send();
+  }
+
+  if (result != APP_MSG_OK) {
+    // Not fatal, the request will just go out on a cold connection
+    LOG_DEBUG("Failed to send REQUEST_INTENT: %d", (int)result);
   }
 }
 
@@ -342,15 +1210,132 @@ static void dictation_session_callback(DictationSession *session, DictationSessi
   if (status == DictationSessionStatusSuccess && transcription) {
     // Add the transcription as a user message
     add_user_message(transcription);
-    scroll_to_bottom();
+    schedule_ui_update(UI_DIRTY_SCROLL_BOTTOM);
+
+    // Send it to JS now, or once the phone is reachable
+    flush_queue();
+  }
+
+  // The session is kept for the next question
+}
+#endif
+
+// Put a message from the phone's log next to the window, if it's adjacent
+static void receive_history(int index, bool is_user, const char *text, uint16_t response_id, int total_pages) {
+  if (index == s_history_request_index) {
+    s_history_request_index = -1;
+  }
+
+  // The first message of a conversation being opened, the view starts at the bottom
+  if (s_message_count == 0) {
+    schedule_ui_update(UI_DIRTY_SCROLL_BOTTOM);
+  }
+
+  Message *message;
+  bool prepended = (index == s_base_index - 1);
+  if (prepended) {
+    message = unshift_message();
+  } else if (index == s_base_index + s_message_count && s_message_count > 0) {
+    if (s_message_count >= s_capacity) {
+      // The oldest message is above the view, scroll up by its height to stay in place
+      s_scroll_shift += message_height(&s_messages[0]);
+      shift_messages();
+    }
+    message = &s_messages[s_message_count++];
+  } else {
+    LOG_DEBUG("Ignoring stale history message %d", index);
+    return;
+  }
+
+  message->is_user = is_user;
+  message->is_pending = false;
+  message->response_id = response_id;
+  message->first_page = 0;
+  message->total_pages = total_pages;
+  message->text[0] = '\0';
+  set_message_height(message, 0);
+  if (response_id != 0) {
+    message->resident_pages = 0;
+    append_page(message, text, utf8_prefix_length(text, page_bytes()));
+  } else {
+    snprintf(message->text, s_text_size, "%s", text);
+  }
 
-    // Send chat request to JS
-    send_chat_request();
+  if (prepended) {
+    // Prepended above the view, scroll down by its height to stay in place
+    set_message_height(message, message_bubble_measure_height(message->text, s_content_width));
+    s_scroll_shift -= message->height;
   }
 
-  // Clean up the dictation session
-  dictation_session_destroy(s_dictation_session);
-  s_dictation_session = NULL;
+  schedule_ui_update(UI_DIRTY_CONTENT);
+}
+
+// Ask the phone for up to HISTORY_BATCH_SIZE messages starting at index, walking
+// towards older messages if direction is negative
+static void request_history(int index, int direction) {
+  time_t now = time(NULL);
+  if (index == s_history_request_index && now - s_history_request_time < PAGE_REQUEST_TIMEOUT_S) {
+    return;
+  }
+
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return;
+  }
+
+  dict_write_uint32(iter, MESSAGE_KEY_CONVERSATION_ID, s_conversation_id);
+  dict_write_int32(iter, MESSAGE_KEY_REQUEST_HISTORY, index);
+  dict_write_int32(iter, MESSAGE_KEY_HISTORY_COUNT, direction < 0 ? -HISTORY_BATCH_SIZE : HISTORY_BATCH_SIZE);
+  if (app_message_outbox_send() == APP_MSG_OK) {
+    LOG_DEBUG("Requested history from message %d", index);
+    s_history_request_index = index;
+    s_history_request_time = now;
+  }
+}
+
+// Fetch older or newer messages when the view gets close to either end of the window
+static void request_history_near(int view_top) {
+  if (s_waiting_for_response || s_message_count == 0) {
+    // New messages are being added at the end of the log
+    return;
+  }
+
+  int view_height = layer_get_bounds(scroll_layer_get_layer(s_scroll_layer)).size.h;
+  int content_height = layer_get_bounds(s_content_layer).size.h;
+
+  if (s_base_index > s_history_floor && view_top < PAGE_PREFETCH_DISTANCE) {
+    request_history(s_base_index - 1, -1);
+  } else if (!window_at_log_end() && content_height - (view_top + view_height) < PAGE_PREFETCH_DISTANCE) {
+    int next = s_base_index + s_message_count;
+    if (restore_queued_turn(next)) {
+      // Back at the queued questions, send the oldest if it's due
+      flush_queue();
+    } else {
+      request_history(next, 1);
+    }
+  }
+}
+
+// Show a conversation from the phone's log: its newest messages are fetched, older
+// ones as the user scrolls up
+static void open_conversation(uint32_t conversation_id, int length) {
+  if (offline_queue_count() > 0 && offline_queue_conversation_id() == conversation_id) {
+    // Its questions are still queued, they're the end of the window
+    resume_queued_turns();
+  } else {
+    // Questions of another conversation are dropped, as when starting a new one
+    offline_queue_clear();
+    s_conversation_id = conversation_id;
+    s_base_index = length;
+    s_log_length = length;
+    s_message_count = 0;
+    s_history_floor = 0;
+    s_history_request_index = -1;
+  }
+
+  if (s_base_index > 0) {
+    request_history(s_base_index - 1, -1);
+  }
 }
 
 static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -358,6 +1343,9 @@ static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
   GPoint offset = scroll_layer_get_content_offset(s_scroll_layer);
   offset.y += SCROLL_OFFSET;
   scroll_layer_set_content_offset(s_scroll_layer, offset, true);
+  s_layout_follow_bottom = false;
+  request_pages_near(-offset.y);
+  request_history_near(-offset.y);
 }
 
 static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -365,52 +1353,100 @@ static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
   GPoint offset = scroll_layer_get_content_offset(s_scroll_layer);
   offset.y -= SCROLL_OFFSET;
   scroll_layer_set_content_offset(s_scroll_layer, offset, true);
+  s_layout_follow_bottom = false;
+  request_pages_near(-offset.y);
+  request_history_near(-offset.y);
 }
 
-static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
-  if (s_message_count > 0) {
-    // Clear chat history
-    s_message_count = 0;
-    s_waiting_for_response = false;
+// Scroll so the view starts at content offset y, as far as the content allows
+static void jump_to(int y) {
+  int view_height = layer_get_bounds(scroll_layer_get_layer(s_scroll_layer)).size.h;
+  int max_y = layer_get_bounds(s_content_layer).size.h - view_height;
+  if (y > max_y) {
+    y = max_y;
+  }
+  if (y < 0) {
+    y = 0;
+  }
 
-    // Stop footer animation if running
-    chat_window_set_footer_animating(false);
+  scroll_layer_set_content_offset(s_scroll_layer, GPoint(0, -y), true);
+  s_layout_follow_bottom = false;
+  request_pages_near(y);
+  request_history_near(y);
+}
 
-    // Rebuild UI to show empty state
-    rebuild_scroll_content();
-  } else {
-    // No messages, exit the app
-    window_stack_pop(true);
+static void up_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  // Jump to the start of the message at the top of the view, or of the one
+  // before it if the view is already there
+  int view_top = -scroll_layer_get_content_offset(s_scroll_layer).y;
+  int i = message_at(view_top);
+  if (message_top(i) >= view_top && i > 0) {
+    i--;
   }
+  jump_to(message_top(i));
+}
+
+static void down_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  // Jump to the start of the next message, or to the end from the last one
+  int view_top = -scroll_layer_get_content_offset(s_scroll_layer).y;
+  int next = message_at(view_top) + 1;
+  jump_to(next < laid_out_count() ? message_top(next) : layer_get_bounds(s_content_layer).size.h);
 }
 
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
-  // Don't allow dictation if waiting for response
-  if (s_waiting_for_response) {
+  // Dictation is allowed while an answer is on its way, up to a full queue
+  if (offline_queue_count() >= OFFLINE_QUEUE_CAPACITY) {
+    vibes_short_pulse();
     return;
   }
 
   // Start dictation session
-  s_dictation_session = dictation_session_create(sizeof(char) * 256, dictation_session_callback, NULL);
-
+#if defined(PBL_MICROPHONE)
   if (s_dictation_session) {
     dictation_session_start(s_dictation_session);
+    send_request_intent();
   }
+#endif
 }
 
 static void click_config_provider(void *context) {
-  window_single_repeating_click_subscribe(BUTTON_ID_UP, 100, up_click_handler);
-  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, 100, down_click_handler);
+  // Holding a button jumps a message at a time instead of repeating the scroll
+  window_single_click_subscribe(BUTTON_ID_UP, up_click_handler);
+  window_single_click_subscribe(BUTTON_ID_DOWN, down_click_handler);
+  window_long_click_subscribe(BUTTON_ID_UP, JUMP_HOLD_MS, up_long_click_handler, NULL);
+  window_long_click_subscribe(BUTTON_ID_DOWN, JUMP_HOLD_MS, down_long_click_handler, NULL);
   window_single_click_subscribe(BUTTON_ID_SELECT, select_click_handler);
-  window_single_click_subscribe(BUTTON_ID_BACK, back_click_handler);
 }
 
 static void window_unload(Window *window) {
+  // Drop pending UI work, the layers it would touch are going away
+  if (s_ui_timer) {
+    app_timer_cancel(s_ui_timer);
+    s_ui_timer = NULL;
+  }
+  s_ui_dirty = 0;
+  if (s_layout_timer) {
+    app_timer_cancel(s_layout_timer);
+    s_layout_timer = NULL;
+  }
+  memset(s_action_bar_icons, 0, sizeof(s_action_bar_icons));
+
+  // Queued questions stay in persistent storage for the next time the window opens
+  connection_service_unsubscribe();
+  link_mode_release();
+  if (s_flush_timer) {
+    app_timer_cancel(s_flush_timer);
+    s_flush_timer = NULL;
+  }
+  s_waiting_for_response = false;
+
   // Clean up dictation session if still active
+#if defined(PBL_MICROPHONE)
   if (s_dictation_session) {
     dictation_session_destroy(s_dictation_session);
     s_dictation_session = NULL;
   }
+#endif
 
   // Destroy all bubbles
   for (int i = 0; i < s_bubble_count; i++) {
@@ -421,8 +1457,13 @@ static void window_unload(Window *window) {
   }
   s_bubble_count = 0;
 
-  // Reset message history
+  // Reset message history and free its text buffers
   s_message_count = 0;
+  for (int i = 0; i < s_capacity; i++) {
+    free(s_messages[i].text);
+    s_messages[i].text = NULL;
+  }
+  s_capacity = 0;
 
   // Destroy footer
   if (s_footer) {
@@ -472,27 +1513,111 @@ static void window_unload(Window *window) {
 }
 
 void chat_window_handle_inbox(DictionaryIterator *iterator) {
+  if (!s_window || !window_is_loaded(s_window)) {
+    // Back at the conversation menu, answers to queued questions are asked for again
+    // when their conversation is opened
+    return;
+  }
+
+  PROFILE_BEGIN(PROFILE_HANDLE_INBOX);
+
   // Handle incoming messages from JS
   Tuple *response_text_tuple = dict_find(iterator, MESSAGE_KEY_RESPONSE_TEXT);
   Tuple *response_end_tuple = dict_find(iterator, MESSAGE_KEY_RESPONSE_END);
-
-  if (response_text_tuple) {
-    // Received complete response text
+  Tuple *response_id_tuple = dict_find(iterator, MESSAGE_KEY_RESPONSE_ID);
+  Tuple *page_tuple = dict_find(iterator, MESSAGE_KEY_RESPONSE_PAGE);
+  Tuple *page_count_tuple = dict_find(iterator, MESSAGE_KEY_RESPONSE_PAGE_COUNT);
+
+  // Answers carry the turn id of their question. One for a question that's no longer
+  // queued was received already (or its conversation was cleared).
+  Tuple *turn_tuple = dict_find(iterator, MESSAGE_KEY_TURN_ID);
+  bool stale_answer = turn_tuple && (offline_queue_count() == 0 ||
+                                     turn_tuple->value->uint32 != offline_queue_first_turn_id());
+
+  Tuple *history_index_tuple = dict_find(iterator, MESSAGE_KEY_HISTORY_INDEX);
+  Tuple *conversation_tuple = dict_find(iterator, MESSAGE_KEY_CONVERSATION_ID);
+  if (history_index_tuple && conversation_tuple && conversation_tuple->value->uint32 != s_conversation_id) {
+    LOG_DEBUG("Ignoring history of another conversation");
+  } else if (history_index_tuple) {
+    // A message from the phone's log, or a note that it doesn't have it
+    int index = history_index_tuple->value->int32;
+    Tuple *history_text_tuple = dict_find(iterator, MESSAGE_KEY_HISTORY_TEXT);
+    Tuple *history_role_tuple = dict_find(iterator, MESSAGE_KEY_HISTORY_ROLE);
+
+    if (history_text_tuple && history_role_tuple) {
+      receive_history(index, history_role_tuple->value->int32 == 0, history_text_tuple->value->cstring,
+                      response_id_tuple ? response_id_tuple->value->int32 : 0,
+                      page_count_tuple ? page_count_tuple->value->int32 : 1);
+    } else if (index < s_base_index) {
+      s_history_floor = index + 1;
+    } else {
+      // The phone's log ends here, questions queued after it aren't on the phone yet
+      s_log_length = offline_queue_count() > 0 ? offline_queue_first_index() + offline_queue_count() : index;
+    }
+  } else if (stale_answer) {
+    LOG_DEBUG("Ignoring repeated answer to turn %d", (int)turn_tuple->value->uint32);
+  } else if (response_text_tuple) {
     const char *text = response_text_tuple->value->cstring;
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "Received RESPONSE_TEXT: %s", text);
+    LOG_DEBUG("Received RESPONSE_TEXT: %d bytes, %.*s", (int)strlen(text), LOG_SUMMARY_CHARS, text);
 
-    // Add as new assistant message
-    add_assistant_message(text);
+    if (s_waiting_for_response) {
+      // More of the answer may follow, the link stays fast until its end
+      link_mode_hold(TURN_TIMEOUT_MS);
+    }
+
+    if (response_id_tuple && page_tuple && page_count_tuple) {
+      // One page of a response that JS holds in full
+      receive_response_page(response_id_tuple->value->int32, page_tuple->value->int32,
+                            page_count_tuple->value->int32, text);
+    } else {
+      // Received complete response text
+      add_assistant_message(text);
+    }
+  } else if (response_id_tuple && page_count_tuple && page_count_tuple->value->int32 == 0) {
+    // JS no longer has this response, keep what's resident and stop paging
+    Message *message = find_response(response_id_tuple->value->int32);
+    if (message) {
+      message->response_id = 0;
+    }
+    if (response_id_tuple->value->int32 == s_page_request_id) {
+      end_page_request();
+    }
   }
 
-  if (response_end_tuple) {
+  if (response_end_tuple && !stale_answer) {
     // Response complete - unlock UI
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "Received RESPONSE_END");
+    LOG_DEBUG("Received RESPONSE_END");
+
+    if (offline_queue_count() > 0 && (turn_tuple || s_waiting_for_response)) {
+      // The oldest queued question is answered, the next one comes after the answer
+      int position = queued_position(0);
+      if (position >= 0 && position < s_message_count) {
+        s_messages[position].is_pending = false;
+      }
+      offline_queue_pop(offline_queue_first_index() + 2);
+      schedule_flush(0);
+      if (offline_queue_count() == 0) {
+        resume_wakeup_answered();
+      }
+    }
+
+    PROFILE_SPAN_END(PROFILE_TURN_LATENCY);
     s_waiting_for_response = false;
+    if (offline_queue_count() == 0) {
+      // Otherwise the next question goes out right away, on the fast link
+      link_mode_release();
+    }
     chat_window_set_footer_animating(false);
 
-    // Update action bar to show mic again
-    update_action_bar();
+    // Update the question and action bar to show mic again
+    schedule_ui_update(UI_DIRTY_CONTENT);
+  }
+
+  PROFILE_END(PROFILE_HANDLE_INBOX);
+
+  // Log the timings gathered so far once per turn
+  if (response_end_tuple) {
+    PROFILE_DUMP();
   }
 }
 
@@ -507,12 +1632,28 @@ Window* chat_window_create(void) {
   return s_window;
 }
 
+void chat_window_open_conversation(uint32_t conversation_id, int length) {
+  s_open_id = conversation_id;
+  s_open_length = length;
+  s_open_picked = true;
+}
+
 void chat_window_destroy(Window *window) {
   if (window) {
     window_destroy(window);
   }
 }
 
+void chat_window_handle_outbox_failed(DictionaryIterator *iterator) {
+  if (!s_waiting_for_response || !dict_find(iterator, MESSAGE_KEY_REQUEST_CHAT)) {
+    return;
+  }
+
+  // The question didn't reach the phone, keep it queued and try again
+  requeue_in_flight();
+  schedule_flush(QUEUE_RETRY_DELAY_MS);
+}
+
 void chat_window_set_footer_animating(bool animating) {
   if (!s_footer) {
     return;
@@ -529,12 +1670,23 @@ void chat_window_set_provider_name(const char *name) {
   if (name) {
     snprintf(s_provider_name, sizeof(s_provider_name), "%s", name);
 
-    // Recreate footer with new provider name if it exists
-    if (s_footer && s_window) {
-      chat_footer_destroy(s_footer);
-      s_footer = chat_footer_create(s_content_width, s_provider_name);
-      // Footer will be re-added to content layer on next rebuild
-      rebuild_scroll_content();
+    // Update footer in place, its height may change so relayout
+    if (s_footer) {
+      chat_footer_set_provider(s_footer, s_provider_name, s_provider_available);
+      schedule_ui_update(UI_DIRTY_CONTENT);
     }
   }
 }
+
+void chat_window_set_provider_available(bool available) {
+  if (available == s_provider_available) {
+    return;
+  }
+  s_provider_available = available;
+
+  // Update footer in place, its height may change so relayout
+  if (s_footer) {
+    chat_footer_set_provider(s_footer, s_provider_name, s_provider_available);
+    schedule_ui_update(UI_DIRTY_CONTENT);
+  }
+}
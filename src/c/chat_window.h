@@ -14,6 +14,13 @@
  */
 Window* chat_window_create(void);
 
+/**
+ * Pick the conversation to show the next time the window is pushed.
+ * @param conversation_id Conversation on the phone, 0 to start a new one
+ * @param length Number of messages in it
+ */
+void chat_window_open_conversation(uint32_t conversation_id, int length);
+
 /**
  * Destroy the chat window and free its resources.
  * @param window The window to destroy
@@ -32,8 +39,20 @@ void chat_window_set_footer_animating(bool animating);
  */
 void chat_window_handle_inbox(DictionaryIterator *iterator);
 
+/**
+ * Handle a message to JavaScript that couldn't be delivered.
+ * @param iterator Dictionary iterator with the message data
+ */
+void chat_window_handle_outbox_failed(DictionaryIterator *iterator);
+
 /**
  * Set the provider name displayed in the chat window.
  * @param name The provider name to display
  */
 void chat_window_set_provider_name(const char *name);
+
+/**
+ * Set whether the provider is currently responding (from its circuit breaker).
+ * @param available false while requests to the provider are failing
+ */
+void chat_window_set_provider_available(bool available);
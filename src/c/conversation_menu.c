@@ -0,0 +1,212 @@
+#include "conversation_menu.h"
+#include "logging.h"
+#include <string.h>
+
+// Index entries kept while the menu is visible. Rows are fetched in batches
+// of half of it, so the rows on screen never span more than two batches.
+#define CACHE_SIZE 16
+#define BATCH_SIZE (CACHE_SIZE / 2)
+
+#define TITLE_SIZE 32
+
+// A batch that hasn't arrived by then is asked for again
+#define REQUEST_TIMEOUT_S 3
+
+typedef struct {
+  int32_t position;  // Row of the conversation in the index, -1 for an empty slot
+  uint32_t id;
+  uint32_t updated;  // Seconds
+  uint16_t length;
+  char title[TITLE_SIZE];
+} ConversationEntry;
+
+static Window *s_window;
+static MenuLayer *s_menu_layer;
+static ConversationOpenHandler s_open_handler;
+
+static ConversationEntry *s_cache;  // CACHE_SIZE entries, slot position % CACHE_SIZE
+static int s_total = -1;  // Conversations on the phone, -1 until it says
+static int s_request_start = -1;
+static time_t s_request_time;
+
+static ConversationEntry* cached_entry(int position) {
+  if (!s_cache) {
+    return NULL;
+  }
+
+  ConversationEntry *entry = &s_cache[position % CACHE_SIZE];
+  return entry->position == position ? entry : NULL;
+}
+
+// Ask the phone for the batch of rows that includes position
+static void request_batch(int position) {
+  int start = position - position % BATCH_SIZE;
+  time_t now = time(NULL);
+  if (start == s_request_start && now - s_request_time < REQUEST_TIMEOUT_S) {
+    return;
+  }
+
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return;
+  }
+
+  dict_write_int32(iter, MESSAGE_KEY_REQUEST_CONVERSATIONS, start);
+  dict_write_int32(iter, MESSAGE_KEY_HISTORY_COUNT, BATCH_SIZE);
+  if (app_message_outbox_send() == APP_MSG_OK) {
+    LOG_DEBUG("Requested conversations from %d", start);
+    s_request_start = start;
+    s_request_time = now;
+  }
+}
+
+// "12 messages, 3h ago"
+static void format_subtitle(const ConversationEntry *entry, char *buffer, size_t size) {
+  int age = (int)(time(NULL) - (time_t)entry->updated);
+  if (age < 60 * 60) {
+    snprintf(buffer, size, "%d messages, %dm ago", entry->length, age / 60);
+  } else if (age < 24 * 60 * 60) {
+    snprintf(buffer, size, "%d messages, %dh ago", entry->length, age / (60 * 60));
+  } else {
+    snprintf(buffer, size, "%d messages, %dd ago", entry->length, age / (24 * 60 * 60));
+  }
+}
+
+static uint16_t get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *context) {
+  // "New conversation", then the index (one placeholder row until the phone says how long it is)
+  return 1 + (s_total < 0 ? 1 : s_total);
+}
+
+static void draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *context) {
+  if (cell_index->row == 0) {
+    menu_cell_basic_draw(ctx, cell_layer, "New conversation", NULL, NULL);
+    return;
+  }
+
+  int position = cell_index->row - 1;
+  ConversationEntry *entry = cached_entry(position);
+  if (!entry) {
+    // Drawn again once the phone has sent it
+    menu_cell_basic_draw(ctx, cell_layer, "...", NULL, NULL);
+    request_batch(position);
+    return;
+  }
+
+  char subtitle[32];
+  format_subtitle(entry, subtitle, sizeof(subtitle));
+  menu_cell_basic_draw(ctx, cell_layer, entry->title[0] ? entry->title : "Untitled", subtitle, NULL);
+}
+
+static void select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *context) {
+  if (cell_index->row == 0) {
+    s_open_handler(0, 0);
+    return;
+  }
+
+  ConversationEntry *entry = cached_entry(cell_index->row - 1);
+  if (entry) {
+    s_open_handler(entry->id, entry->length);
+  }
+}
+
+// Copy a title, cut on a character boundary
+static void copy_title(char *title, const char *text) {
+  size_t len = strlen(text);
+  if (len >= TITLE_SIZE) {
+    len = TITLE_SIZE - 1;
+    while (len > 0 && ((uint8_t)text[len] & 0xC0) == 0x80) {
+      len--;
+    }
+  }
+  memcpy(title, text, len);
+  title[len] = '\0';
+}
+
+static void window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+  GRect bounds = layer_get_bounds(window_layer);
+
+  s_menu_layer = menu_layer_create(bounds);
+  menu_layer_set_callbacks(s_menu_layer, NULL, (MenuLayerCallbacks) {
+    .get_num_rows = get_num_rows_callback,
+    .draw_row = draw_row_callback,
+    .select_click = select_callback,
+  });
+  menu_layer_set_highlight_colors(s_menu_layer, PBL_IF_COLOR_ELSE(GColorRajah, GColorBlack), GColorWhite);
+  menu_layer_set_click_config_onto_window(s_menu_layer, window);
+  layer_add_child(window_layer, menu_layer_get_layer(s_menu_layer));
+}
+
+static void window_appear(Window *window) {
+  // The index may have changed while a chat was open, rows are fetched again as
+  // they're drawn
+  s_cache = malloc(CACHE_SIZE * sizeof(ConversationEntry));
+  if (s_cache) {
+    for (int i = 0; i < CACHE_SIZE; i++) {
+      s_cache[i].position = -1;
+    }
+  }
+  s_request_start = -1;
+  menu_layer_reload_data(s_menu_layer);
+}
+
+static void window_disappear(Window *window) {
+  // Give the memory to the chat
+  free(s_cache);
+  s_cache = NULL;
+}
+
+static void window_unload(Window *window) {
+  menu_layer_destroy(s_menu_layer);
+  s_menu_layer = NULL;
+}
+
+Window* conversation_menu_create(ConversationOpenHandler handler) {
+  s_open_handler = handler;
+  s_window = window_create();
+  window_set_window_handlers(s_window, (WindowHandlers) {
+    .load = window_load,
+    .appear = window_appear,
+    .disappear = window_disappear,
+    .unload = window_unload,
+  });
+
+  return s_window;
+}
+
+void conversation_menu_destroy(Window *window) {
+  if (window) {
+    window_destroy(window);
+  }
+}
+
+void conversation_menu_handle_inbox(DictionaryIterator *iterator) {
+  Tuple *total_tuple = dict_find(iterator, MESSAGE_KEY_CONVERSATION_TOTAL);
+  if (!total_tuple || !s_cache) {
+    return;
+  }
+
+  s_total = total_tuple->value->int32;
+
+  Tuple *index_tuple = dict_find(iterator, MESSAGE_KEY_CONVERSATION_INDEX);
+  Tuple *id_tuple = dict_find(iterator, MESSAGE_KEY_CONVERSATION_ID);
+  Tuple *title_tuple = dict_find(iterator, MESSAGE_KEY_CONVERSATION_TITLE);
+  Tuple *updated_tuple = dict_find(iterator, MESSAGE_KEY_CONVERSATION_UPDATED);
+  Tuple *length_tuple = dict_find(iterator, MESSAGE_KEY_CONVERSATION_LENGTH);
+  if (index_tuple && id_tuple && title_tuple && updated_tuple && length_tuple) {
+    int position = index_tuple->value->int32;
+    ConversationEntry *entry = &s_cache[position % CACHE_SIZE];
+    entry->position = position;
+    entry->id = id_tuple->value->uint32;
+    entry->updated = updated_tuple->value->uint32;
+    entry->length = length_tuple->value->int32;
+    copy_title(entry->title, title_tuple->value->cstring);
+
+    if (position == s_request_start + BATCH_SIZE - 1 || position == s_total - 1) {
+      // The last of the batch, rows that are still missing can be asked for again
+      s_request_start = -1;
+    }
+  }
+
+  menu_layer_reload_data(s_menu_layer);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <pebble.h>
+
+/**
+ * Conversation Menu - Lists the conversations kept on the phone
+ *
+ * The first row starts a new conversation, the others open one. The index
+ * (title, last update, message count) is fetched from the phone a batch of
+ * rows at a time as they're drawn, and only kept while the menu is on
+ * screen, so an open chat doesn't pay for it.
+ */
+
+/**
+ * Called when a row is selected.
+ * @param conversation_id The conversation to open, 0 for a new one
+ * @param length Number of messages in it
+ */
+typedef void (*ConversationOpenHandler)(uint32_t conversation_id, int length);
+
+/**
+ * Create the conversation menu window.
+ * @param handler Called when the user picks a conversation
+ * @return Pointer to the created window
+ */
+Window* conversation_menu_create(ConversationOpenHandler handler);
+
+/**
+ * Destroy the conversation menu window and free its resources.
+ * @param window The window to destroy
+ */
+void conversation_menu_destroy(Window *window);
+
+/**
+ * Handle incoming AppMessage from JavaScript (conversation index entries).
+ * @param iterator Dictionary iterator with message data
+ */
+void conversation_menu_handle_inbox(DictionaryIterator *iterator);
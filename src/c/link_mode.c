@@ -0,0 +1,59 @@
+#include "link_mode.h"
+#include "logging.h"
+#include "power_policy.h"
+#include "profiler.h"
+
+static AppTimer *s_release_timer = NULL;
+// When the release timer fires, holds only ever move it later
+static uint32_t s_release_at_ms;
+
+// Current time in milliseconds (wraps, only differences are meaningful)
+static uint32_t now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+static void release_timer_callback(void *context) {
+  s_release_timer = NULL;
+  LOG_DEBUG("Fast link timed out");
+  link_mode_release();
+}
+
+void link_mode_hold(uint32_t timeout_ms) {
+  uint32_t hold_ms = timeout_ms;
+  if (hold_ms > power_policy_link_hold_max_ms()) {
+    hold_ms = power_policy_link_hold_max_ms();
+  }
+  uint32_t now = now_ms();
+  if (s_release_timer) {
+    // A shorter wait (a page fetch during a turn) doesn't cut a longer one short
+    if ((int32_t)(now + hold_ms - s_release_at_ms) > 0) {
+      app_timer_reschedule(s_release_timer, hold_ms);
+      s_release_at_ms = now + hold_ms;
+    }
+    return;
+  }
+
+  s_release_timer = app_timer_register(hold_ms, release_timer_callback, NULL);
+  s_release_at_ms = now + hold_ms;
+#if FAST_LINK_ENABLED
+  app_comm_set_sniff_interval(SNIFF_INTERVAL_REDUCED);
+  PROFILE_SPAN_BEGIN(PROFILE_FAST_LINK);
+#endif
+}
+
+void link_mode_release(void) {
+  if (s_release_timer) {
+    app_timer_cancel(s_release_timer);
+    s_release_timer = NULL;
+  }
+
+#if FAST_LINK_ENABLED
+  PROFILE_SPAN_END(PROFILE_FAST_LINK);
+  if (app_comm_get_sniff_interval() != SNIFF_INTERVAL_NORMAL) {
+    app_comm_set_sniff_interval(SNIFF_INTERVAL_NORMAL);
+  }
+#endif
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <pebble.h>
+
+/**
+ * Link Mode
+ *
+ * Puts the Bluetooth link on the reduced sniff interval while the watch is
+ * waiting on the phone, so each AppMessage round trip of a turn is faster,
+ * and back to the normal interval as soon as the wait is over. A safety
+ * timeout reverts it if the answer never comes: the caller's estimate of
+ * the wait, capped by the power policy.
+ * Build with BIT_AI_FAST_LINK=0 to leave the link alone, e.g. to measure the
+ * mode against the default.
+ */
+
+#ifndef FAST_LINK_ENABLED
+#define FAST_LINK_ENABLED 1
+#endif
+
+/**
+ * Switch to the reduced sniff interval, or push the safety timeout back if it's already
+ * on (never earlier than a previous hold set it).
+ * @param timeout_ms Longest the wait can take, the link goes back to normal after
+ *        this long (or sooner when saving power) unless held again
+ */
+void link_mode_hold(uint32_t timeout_ms);
+
+/**
+ * Go back to the normal sniff interval.
+ */
+void link_mode_release(void);
@@ -0,0 +1,46 @@
+#pragma once
+#include <pebble.h>
+
+/**
+ * Logging
+ *
+ * APP_LOG with a level fixed at compile time. Messages above LOG_LEVEL
+ * compile to nothing, arguments included, so a release build neither
+ * formats nor sends them. The default keeps warnings, errors and the info
+ * messages that report timings; build with BIT_AI_LOG_LEVEL=debug for the
+ * rest (or error, warning). Log sizes and short prefixes of payloads, never
+ * whole messages. The profiler and the measurement check log directly,
+ * they're only built when asked for.
+ */
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARNING 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Longest prefix of a payload that's logged, for "%.*s"
+#define LOG_SUMMARY_CHARS 32
+
+#define LOG_ERROR(fmt, args...) APP_LOG(APP_LOG_LEVEL_ERROR, fmt, ## args)
+
+#if LOG_LEVEL >= LOG_LEVEL_WARNING
+#define LOG_WARNING(fmt, args...) APP_LOG(APP_LOG_LEVEL_WARNING, fmt, ## args)
+#else
+#define LOG_WARNING(fmt, args...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, args...) APP_LOG(APP_LOG_LEVEL_INFO, fmt, ## args)
+#else
+#define LOG_INFO(fmt, args...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, args...) APP_LOG(APP_LOG_LEVEL_DEBUG, fmt, ## args)
+#else
+#define LOG_DEBUG(fmt, args...) ((void)0)
+#endif
@@ -0,0 +1,79 @@
+#include "memory_governor.h"
+#include "logging.h"
+
+// Heap kept free for everything that isn't history (dictation UI, AppMessage
+// handling, text layout, timers)
+#define RESERVE_BYTES PROFILE_HEAP_RESERVE_BYTES
+
+// Free heap below which older turns are evicted to give memory back
+#define LOW_WATERMARK_BYTES 2048
+
+// Approximate heap cost of a pooled bubble (MessageBubble, Layer, TextLayer)
+#define BUBBLE_OVERHEAD_BYTES 160
+
+#define MIN_CAPACITY 4
+#define PREFERRED_CAPACITY (PROFILE_LEAN ? 6 : 10)
+
+// Text budgets to try, largest first
+static const int s_text_sizes[] = { 1024, 512, 256, 128 };
+#define NUM_TEXT_SIZES (int)(sizeof(s_text_sizes) / sizeof(s_text_sizes[0]))
+
+static int s_text_size = 512;
+
+static int message_cost(int text_size) {
+  return text_size + BUBBLE_OVERHEAD_BYTES;
+}
+
+MemoryPlan memory_governor_plan(void) {
+  int free_bytes = (int)heap_bytes_free();
+  int available = free_bytes - RESERVE_BYTES;
+
+  // Use the largest text budget that still fits the preferred history depth,
+  // falling back to the smallest one when memory is really tight
+  int text_size = s_text_sizes[NUM_TEXT_SIZES - 1];
+  for (int i = 0; i < NUM_TEXT_SIZES; i++) {
+    if (available >= PREFERRED_CAPACITY * message_cost(s_text_sizes[i])) {
+      text_size = s_text_sizes[i];
+      break;
+    }
+  }
+
+  int capacity = available / message_cost(text_size);
+  if (capacity > MEMORY_GOVERNOR_MAX_CAPACITY) {
+    capacity = MEMORY_GOVERNOR_MAX_CAPACITY;
+  }
+  if (capacity < MIN_CAPACITY) {
+    capacity = MIN_CAPACITY;
+  }
+
+  s_text_size = text_size;
+
+  LOG_INFO("Memory plan: %d free, %d messages x %d bytes", free_bytes, capacity, text_size);
+
+  return (MemoryPlan) {
+    .capacity = capacity,
+    .text_size = text_size,
+  };
+}
+
+int memory_governor_check(int capacity) {
+  int free_bytes = (int)heap_bytes_free();
+  if (free_bytes >= LOW_WATERMARK_BYTES || capacity <= 2) {
+    return capacity;
+  }
+
+  // Free enough whole turns (user + assistant) to get back above the watermark
+  int cost = message_cost(s_text_size);
+  int evict = (LOW_WATERMARK_BYTES - free_bytes + cost - 1) / cost;
+  evict += evict % 2;
+
+  int new_capacity = capacity - evict;
+  if (new_capacity < 2) {
+    new_capacity = 2;
+  }
+
+  LOG_WARNING("Low memory: %d free, shrinking history from %d to %d messages",
+              free_bytes, capacity, new_capacity);
+
+  return new_capacity;
+}
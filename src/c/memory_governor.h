@@ -0,0 +1,33 @@
+#pragma once
+#include <pebble.h>
+#include "build_profile.h"
+
+/**
+ * Memory Governor
+ *
+ * Decides how much chat history fits in the heap: picks the history
+ * capacity and per-message text budget at startup from the free heap,
+ * and tells the chat window when to give memory back during a session.
+ */
+
+// Upper bound on history capacity (sizes the static per-message arrays)
+#define MEMORY_GOVERNOR_MAX_CAPACITY PROFILE_MAX_HISTORY
+
+typedef struct {
+  int capacity;   // Number of messages kept in history
+  int text_size;  // Bytes of text per message, including the terminator
+} MemoryPlan;
+
+/**
+ * Choose history capacity and text budget from the currently free heap.
+ * Call this right before allocating the message storage.
+ * @return The chosen plan
+ */
+MemoryPlan memory_governor_plan(void);
+
+/**
+ * Check the free heap before an allocation-heavy step.
+ * @param capacity The current history capacity
+ * @return The capacity to shrink to (equal to capacity if memory is fine)
+ */
+int memory_governor_check(int capacity);
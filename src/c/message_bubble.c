@@ -1,13 +1,32 @@
 #include "message_bubble.h"
+#include "profiler.h"
 
 #define MESSAGE_PADDING 10
 #define MESSAGE_FONT FONT_KEY_GOTHIC_24_BOLD
 
+// Rough line metrics of MESSAGE_FONT, only used for estimates
+#define ESTIMATE_LINE_HEIGHT 26
+#define ESTIMATE_CHAR_WIDTH 9
+
+// 32-bit FNV-1a, to tell whether the measured part of a text is unchanged
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
 struct MessageBubble {
   Layer *layer;
   TextLayer *text_layer;
   bool is_user;
+  bool is_pending;
   int max_width;
+
+  // Last measurement, reused while the text is only appended to. Paragraphs
+  // before tail_start are done, only the trailing one is laid out again.
+  const char *measured_text;
+  size_t measured_len;
+  uint32_t measured_hash;  // Of the measured_len bytes
+  size_t tail_start;       // Start of the trailing paragraph
+  int16_t prefix_height;   // Height of the paragraphs before it
+  int16_t measured_height;
 };
 
 static void background_update_proc(Layer *layer, GContext *ctx) {
@@ -17,7 +36,12 @@ static void background_update_proc(Layer *layer, GContext *ctx) {
   }
 
   // Only draw background for user messages (rectangle spanning full width)
-  if (bubble->is_user) {
+  if (bubble->is_user && bubble->is_pending) {
+    // Queued, outlined until it has been sent
+    GRect bounds = layer_get_bounds(layer);
+    graphics_context_set_stroke_color(ctx, PBL_IF_COLOR_ELSE(GColorRajah, GColorBlack));
+    graphics_draw_rect(ctx, bounds);
+  } else if (bubble->is_user) {
     GRect bounds = layer_get_bounds(layer);
     graphics_context_set_fill_color(ctx, PBL_IF_COLOR_ELSE(GColorRajah, GColorLightGray));
     graphics_fill_rect(ctx, bounds, 0, GCornerNone);  // No rounded corners
@@ -25,39 +49,114 @@ static void background_update_proc(Layer *layer, GContext *ctx) {
   // Claude messages have no background (white on white)
 }
 
+// Size of the wrapped text inside a bubble of the given width
+static GSize measure_text(const char *text, int max_width) {
+  int available_text_width = max_width - (MESSAGE_PADDING * 2);
+  return graphics_text_layout_get_content_size(
+    text,
+    fonts_get_system_font(MESSAGE_FONT),
+    GRect(0, 0, available_text_width, 2000),
+    GTextOverflowModeWordWrap,
+    GTextAlignmentLeft
+  );
+}
+
+static uint32_t hash_bytes(uint32_t hash, const char *bytes, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (uint8_t)bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+// Height of the bubble's new text. Appended text is measured together with the
+// trailing paragraph only, the height of the paragraphs before it is kept (a
+// paragraph break always starts a new line, so heights add up).
+static int measure_text_incremental(MessageBubble *bubble, const char *text) {
+  size_t len = strlen(text);
+  size_t from = 0;
+  uint32_t hash = FNV_OFFSET_BASIS;
+
+  if (text == bubble->measured_text && len >= bubble->measured_len) {
+    hash = hash_bytes(hash, text, bubble->measured_len);
+    if (hash == bubble->measured_hash) {
+      if (len == bubble->measured_len) {
+        return bubble->measured_height;
+      }
+      from = bubble->measured_len;
+    } else {
+      hash = FNV_OFFSET_BASIS;
+    }
+  }
+
+  if (from == 0) {
+    // New or changed text, measured from scratch
+    bubble->tail_start = 0;
+    bubble->prefix_height = 0;
+  }
+
+  // The trailing paragraph is never left empty, a newline at the very end
+  // stays part of it until text follows
+  size_t old_tail_start = bubble->tail_start;
+  for (size_t i = from > 0 ? from - 1 : 0; i + 1 < len; i++) {
+    if (text[i] == '\n') {
+      bubble->tail_start = i + 1;
+    }
+  }
+
+  GSize tail_size = measure_text(text + bubble->tail_start, bubble->max_width);
+  if (bubble->tail_start != old_tail_start) {
+    // Paragraphs completed since the last measurement
+    GSize completed = measure_text(text + old_tail_start, bubble->max_width);
+    bubble->prefix_height += completed.h - tail_size.h;
+  }
+
+  bubble->measured_text = text;
+  bubble->measured_len = len;
+  bubble->measured_hash = hash_bytes(hash, text + from, len - from);
+  bubble->measured_height = bubble->prefix_height + tail_size.h;
+
+#if MEASURE_CHECK_ENABLED
+  GSize full = measure_text(text, bubble->max_width);
+  if (full.h != bubble->measured_height) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "MEASURE_CHECK mismatch at %d bytes: height %d, full %d", (int)len,
+            bubble->measured_height, full.h);
+  }
+#endif
+
+  return bubble->measured_height;
+}
+
 MessageBubble* message_bubble_create(const char *text, bool is_user, int max_width) {
   MessageBubble *bubble = malloc(sizeof(MessageBubble));
   if (!bubble) {
     return NULL;
   }
 
+  PROFILE_BEGIN(PROFILE_BUBBLE_CREATE);
+
   bubble->is_user = is_user;
+  bubble->is_pending = false;
   bubble->max_width = max_width;
+  bubble->measured_text = NULL;
 
-  // Calculate text size (account for padding so bubble doesn't exceed max_width)
+  // Calculate text height (account for padding so bubble doesn't exceed max_width)
   GFont font = fonts_get_system_font(MESSAGE_FONT);
-  int available_text_width = max_width - (MESSAGE_PADDING * 2);
-  GSize text_size = graphics_text_layout_get_content_size(
-    text,
-    font,
-    GRect(0, 0, available_text_width, 2000),
-    GTextOverflowModeWordWrap,
-    GTextAlignmentLeft
-  );
+  int text_height = measure_text_incremental(bubble, text);
 
   // Bubble spans full width, height based on text + padding
-  int bubble_height = text_size.h + (MESSAGE_PADDING * 2);
+  int bubble_height = text_height + (MESSAGE_PADDING * 2);
 
   // Create container layer with background (full width)
   bubble->layer = layer_create_with_data(GRect(0, 0, max_width, bubble_height), sizeof(MessageBubble*));
   layer_set_update_proc(bubble->layer, background_update_proc);
   *(MessageBubble**)layer_get_data(bubble->layer) = bubble;
 
-  // Create text layer (positioned to center vertically, with extra height for descenders)
+  // Create text layer (positioned to center vertically, with extra height for descenders).
+  // It gets the whole width the text was wrapped to.
   bubble->text_layer = text_layer_create(GRect(
     MESSAGE_PADDING,
     MESSAGE_PADDING / 2,
-    text_size.w,
+    max_width - (MESSAGE_PADDING * 2),
     bubble_height - MESSAGE_PADDING
   ));
   text_layer_set_text(bubble->text_layer, text);
@@ -67,6 +166,7 @@ MessageBubble* message_bubble_create(const char *text, bool is_user, int max_wid
   text_layer_set_text_color(bubble->text_layer, GColorBlack);
   layer_add_child(bubble->layer, text_layer_get_layer(bubble->text_layer));
 
+  PROFILE_END(PROFILE_BUBBLE_CREATE);
   return bubble;
 }
 
@@ -94,19 +194,12 @@ void message_bubble_set_text(MessageBubble *bubble, const char *text) {
   // Update text
   text_layer_set_text(bubble->text_layer, text);
 
-  // Recalculate text size (account for padding so bubble doesn't exceed max_width)
-  GFont font = fonts_get_system_font(MESSAGE_FONT);
-  int available_text_width = bubble->max_width - (MESSAGE_PADDING * 2);
-  GSize text_size = graphics_text_layout_get_content_size(
-    text,
-    font,
-    GRect(0, 0, available_text_width, 2000),
-    GTextOverflowModeWordWrap,
-    GTextAlignmentLeft
-  );
+  // Recalculate text height (account for padding so bubble doesn't exceed max_width),
+  // only the part that changed is laid out again
+  int text_height = measure_text_incremental(bubble, text);
 
   // Update bubble height (width stays at max_width)
-  int bubble_height = text_size.h + (MESSAGE_PADDING * 2);
+  int bubble_height = text_height + (MESSAGE_PADDING * 2);
   GRect frame = layer_get_frame(bubble->layer);
   frame.size.h = bubble_height;
   layer_set_frame(bubble->layer, frame);
@@ -115,7 +208,7 @@ void message_bubble_set_text(MessageBubble *bubble, const char *text) {
   GRect text_frame = GRect(
     MESSAGE_PADDING,
     MESSAGE_PADDING / 2,
-    text_size.w,
+    bubble->max_width - (MESSAGE_PADDING * 2),
     bubble_height - MESSAGE_PADDING
   );
   layer_set_frame(text_layer_get_layer(bubble->text_layer), text_frame);
@@ -123,6 +216,49 @@ void message_bubble_set_text(MessageBubble *bubble, const char *text) {
   layer_mark_dirty(bubble->layer);
 }
 
+void message_bubble_reset(MessageBubble *bubble, const char *text, bool is_user) {
+  if (!bubble) {
+    return;
+  }
+
+  PROFILE_BEGIN(PROFILE_BUBBLE_RESET);
+  bubble->is_user = is_user;
+  message_bubble_set_text(bubble, text);
+  PROFILE_END(PROFILE_BUBBLE_RESET);
+}
+
+void message_bubble_reset_sized(MessageBubble *bubble, const char *text, bool is_user, int height) {
+  if (!bubble || !bubble->text_layer) {
+    return;
+  }
+
+  bubble->is_user = is_user;
+  text_layer_set_text(bubble->text_layer, text);
+
+  GRect frame = layer_get_frame(bubble->layer);
+  if (frame.size.h != height) {
+    frame.size.h = height;
+    layer_set_frame(bubble->layer, frame);
+    layer_set_frame(text_layer_get_layer(bubble->text_layer), GRect(
+      MESSAGE_PADDING,
+      MESSAGE_PADDING / 2,
+      bubble->max_width - (MESSAGE_PADDING * 2),
+      height - MESSAGE_PADDING
+    ));
+  }
+
+  layer_mark_dirty(bubble->layer);
+}
+
+void message_bubble_set_pending(MessageBubble *bubble, bool pending) {
+  if (!bubble || bubble->is_pending == pending) {
+    return;
+  }
+
+  bubble->is_pending = pending;
+  layer_mark_dirty(bubble->layer);
+}
+
 Layer* message_bubble_get_layer(MessageBubble *bubble) {
   return bubble ? bubble->layer : NULL;
 }
@@ -134,3 +270,96 @@ int message_bubble_get_height(MessageBubble *bubble) {
 
   return layer_get_frame(bubble->layer).size.h;
 }
+
+int message_bubble_measure_height(const char *text, int max_width) {
+  return measure_text(text, max_width).h + (MESSAGE_PADDING * 2);
+}
+
+int message_bubble_estimate_height(const char *text, int max_width) {
+  int chars_per_line = (max_width - (MESSAGE_PADDING * 2)) / ESTIMATE_CHAR_WIDTH;
+  int lines = 1;
+  int column = 0;
+
+  // Counts characters, not bytes, and wraps as if words could be split anywhere
+  for (const char *c = text; *c; c++) {
+    if (*c == '\n') {
+      lines++;
+      column = 0;
+    } else if (((uint8_t)*c & 0xC0) != 0x80 && ++column > chars_per_line) {
+      lines++;
+      column = 1;
+    }
+  }
+
+  return lines * ESTIMATE_LINE_HEIGHT + (MESSAGE_PADDING * 2);
+}
+
+#if MEASURE_CHECK_ENABLED
+// Paragraph breaks, blank lines, long words and multi-byte characters
+static const char s_check_text[] =
+  "Streaming answers grow a few words at a time, and each chunk used to lay "
+  "out the whole bubble again.\n"
+  "Short line.\n\n"
+  "A paragraph after a blank line, with an overlongwordthatcannotwrapanywhereatall "
+  "in the middle of it.\n"
+  "Caf\xc3\xa9, na\xc3\xafve, \xe2\x80\x94 dashes \xe2\x80\x94 and \xe2\x80\x9cquotes\xe2\x80\x9d.\n"
+  "- a list item\n- another list item that runs long enough to wrap onto a second line\n"
+  "Last paragraph, ending without a newline";
+
+static const size_t s_check_chunks[] = { 1, 3, 16, 64, sizeof(s_check_text) };
+
+// Compare a bubble's incremental measurement with a full one
+static bool check_size(MessageBubble *bubble, const char *text) {
+  return bubble->measured_height == measure_text(text, bubble->max_width).h;
+}
+
+void message_bubble_measure_check(int max_width) {
+  char *buffer = malloc(sizeof(s_check_text));
+  if (!buffer) {
+    return;
+  }
+
+  MessageBubble *bubble = message_bubble_create("", false, max_width);
+  if (!bubble) {
+    free(buffer);
+    return;
+  }
+
+  int checks = 0;
+  int mismatches = 0;
+  for (size_t c = 0; c < sizeof(s_check_chunks) / sizeof(s_check_chunks[0]); c++) {
+    // Appends, only ever ending on a character boundary
+    size_t len = 0;
+    buffer[0] = '\0';
+    message_bubble_set_text(bubble, buffer);
+    while (len < sizeof(s_check_text) - 1) {
+      size_t next = len + s_check_chunks[c];
+      if (next > sizeof(s_check_text) - 1) {
+        next = sizeof(s_check_text) - 1;
+      }
+      while (next < sizeof(s_check_text) - 1 && (s_check_text[next] & 0xC0) == 0x80) {
+        next++;
+      }
+      memcpy(buffer + len, s_check_text + len, next - len);
+      buffer[next] = '\0';
+      len = next;
+
+      message_bubble_set_text(bubble, buffer);
+      checks++;
+      mismatches += check_size(bubble, buffer) ? 0 : 1;
+    }
+
+    // An edit to the start must not reuse the old measurement
+    buffer[0] = 'X';
+    message_bubble_set_text(bubble, buffer);
+    checks++;
+    mismatches += check_size(bubble, buffer) ? 0 : 1;
+  }
+
+  APP_LOG(mismatches ? APP_LOG_LEVEL_ERROR : APP_LOG_LEVEL_INFO,
+          "MEASURE_CHECK %d measurements, %d mismatches", checks, mismatches);
+
+  message_bubble_destroy(bubble);
+  free(buffer);
+}
+#endif
@@ -6,8 +6,17 @@
  *
  * Displays a single message in the chat with appropriate styling.
  * User messages have grey background, Claude messages have white/clear background.
+ *
+ * Text that grows by appending (streaming, paging) is measured incrementally:
+ * only the trailing paragraph and the new text are laid out again. Build with
+ * BIT_AI_MEASURE_CHECK=1 to compare every incremental measurement with a full
+ * one and run message_bubble_measure_check() when the chat opens.
  */
 
+#ifndef MEASURE_CHECK_ENABLED
+#define MEASURE_CHECK_ENABLED 0
+#endif
+
 typedef struct MessageBubble MessageBubble;
 
 /**
@@ -32,6 +41,31 @@ void message_bubble_destroy(MessageBubble *bubble);
  */
 void message_bubble_set_text(MessageBubble *bubble, const char *text);
 
+/**
+ * Reinitialize a bubble in place for a different message (for pooled reuse).
+ * @param bubble The bubble to reset
+ * @param text The new text to display
+ * @param is_user true if this is a user message (grey background), false for Claude (white)
+ */
+void message_bubble_reset(MessageBubble *bubble, const char *text, bool is_user);
+
+/**
+ * Reinitialize a bubble for a message whose height is already known (or
+ * estimated), without measuring its text.
+ * @param bubble The bubble to reset
+ * @param text The new text to display
+ * @param is_user true if this is a user message (grey background), false for Claude (white)
+ * @param height Height of the bubble in pixels
+ */
+void message_bubble_reset_sized(MessageBubble *bubble, const char *text, bool is_user, int height);
+
+/**
+ * Show a user message as queued (outlined instead of filled) until it reaches the phone.
+ * @param bubble The bubble to update
+ * @param pending true while the message is queued
+ */
+void message_bubble_set_pending(MessageBubble *bubble, bool pending);
+
 /**
  * Get the underlying Layer for adding to view hierarchy.
  * @param bubble The message bubble
@@ -45,3 +79,29 @@ Layer* message_bubble_get_layer(MessageBubble *bubble);
  * @return Height in pixels
  */
 int message_bubble_get_height(MessageBubble *bubble);
+
+/**
+ * Measure the height a bubble would have for the given text, without creating one.
+ * @param text The message text
+ * @param max_width Maximum width for the bubble (for text wrapping)
+ * @return Height in pixels
+ */
+int message_bubble_measure_height(const char *text, int max_width);
+
+/**
+ * Guess the height a bubble would have for the given text from its length,
+ * for layout before it has been measured.
+ * @param text The message text
+ * @param max_width Maximum width for the bubble (for text wrapping)
+ * @return Height in pixels
+ */
+int message_bubble_estimate_height(const char *text, int max_width);
+
+#if MEASURE_CHECK_ENABLED
+/**
+ * Stream sample text into a bubble in chunks of several sizes and log how
+ * many incremental measurements differed from a full measurement.
+ * @param max_width Maximum width for the bubble (for text wrapping)
+ */
+void message_bubble_measure_check(int max_width);
+#endif
@@ -0,0 +1,124 @@
+#include "offline_queue.h"
+#include "logging.h"
+#include <stddef.h>
+#include <string.h>
+
+// Persistent storage keys (1-3 are used by bit_ai.c and power_policy.c). The
+// turns are a ring of OFFLINE_QUEUE_CAPACITY keys starting at PERSIST_KEY_QUEUE_TURNS,
+// so dropping the oldest turn doesn't rewrite the others.
+#define PERSIST_KEY_QUEUE_HEADER 4
+#define PERSIST_KEY_QUEUE_TURNS 5
+
+typedef struct {
+  uint32_t conversation_id;
+  uint32_t next_turn_id;  // Turn ids are consecutive, the newest turn has next_turn_id - 1
+  int32_t first_index;  // Log index of the oldest turn
+  uint8_t head;         // Ring slot of the oldest turn
+  uint8_t count;
+} QueueHeader;
+
+static QueueHeader s_header = { .next_turn_id = 1 };
+
+static uint32_t slot_key(int position) {
+  return PERSIST_KEY_QUEUE_TURNS + (s_header.head + position) % OFFLINE_QUEUE_CAPACITY;
+}
+
+static void save_header(void) {
+  persist_write_data(PERSIST_KEY_QUEUE_HEADER, &s_header, sizeof(s_header));
+}
+
+void offline_queue_init(void) {
+  if (persist_exists(PERSIST_KEY_QUEUE_HEADER)) {
+    persist_read_data(PERSIST_KEY_QUEUE_HEADER, &s_header, sizeof(s_header));
+  }
+
+  if (s_header.count > 0) {
+    LOG_INFO("%d questions still queued", s_header.count);
+  }
+}
+
+int offline_queue_count(void) {
+  return s_header.count;
+}
+
+uint32_t offline_queue_conversation_id(void) {
+  return s_header.conversation_id;
+}
+
+int offline_queue_first_index(void) {
+  return s_header.first_index;
+}
+
+uint32_t offline_queue_first_turn_id(void) {
+  return s_header.next_turn_id - s_header.count;
+}
+
+uint32_t offline_queue_push(uint32_t conversation_id, int log_index, const char *text, size_t len) {
+  if (s_header.count > 0 && s_header.conversation_id != conversation_id) {
+    // Turns of a conversation that was cleared
+    offline_queue_clear();
+  }
+
+  if (s_header.count >= OFFLINE_QUEUE_CAPACITY) {
+    LOG_WARNING("Offline queue is full");
+    return 0;
+  }
+
+  if (s_header.count == 0) {
+    s_header.conversation_id = conversation_id;
+    s_header.first_index = log_index;
+  }
+
+  QueuedTurn turn;
+  turn.turn_id = s_header.next_turn_id;
+  if (len >= sizeof(turn.text)) {
+    len = sizeof(turn.text) - 1;
+  }
+  memcpy(turn.text, text, len);
+  turn.text[len] = '\0';
+
+  // Only the used part of the text is written
+  persist_write_data(slot_key(s_header.count), &turn, offsetof(QueuedTurn, text) + len + 1);
+
+  s_header.next_turn_id++;
+  s_header.count++;
+  save_header();
+  return turn.turn_id;
+}
+
+bool offline_queue_peek(int position, QueuedTurn *turn) {
+  if (position < 0 || position >= s_header.count) {
+    return false;
+  }
+
+  int read = persist_read_data(slot_key(position), turn, sizeof(*turn));
+  if (read <= (int)offsetof(QueuedTurn, text)) {
+    return false;
+  }
+  turn->text[read - offsetof(QueuedTurn, text) - 1] = '\0';
+  return true;
+}
+
+void offline_queue_pop(int next_index) {
+  if (s_header.count == 0) {
+    return;
+  }
+
+  persist_delete(slot_key(0));
+  s_header.head = (s_header.head + 1) % OFFLINE_QUEUE_CAPACITY;
+  s_header.count--;
+  s_header.first_index = next_index;
+  save_header();
+}
+
+void offline_queue_clear(void) {
+  if (s_header.count == 0) {
+    return;
+  }
+
+  for (int i = 0; i < s_header.count; i++) {
+    persist_delete(slot_key(i));
+  }
+  s_header.count = 0;
+  save_header();
+}
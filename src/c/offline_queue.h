@@ -0,0 +1,84 @@
+#pragma once
+#include <pebble.h>
+
+/**
+ * Offline Queue
+ *
+ * Questions waiting to be answered, kept in persistent storage so they
+ * survive the phone being out of reach (and the app being closed). Turns
+ * are sent in order; one stays queued until its answer has arrived. It's
+ * also the pipeline for follow-ups: questions dictated while an answer is
+ * still coming wait here and go out as soon as it's complete.
+ *
+ * Queued turns are always the last messages of the conversation log, each
+ * answer goes in right after its question: turn n of the queue is message
+ * offline_queue_first_index() + n of the log.
+ */
+
+#define OFFLINE_QUEUE_CAPACITY 4
+// Longest question kept, including the terminator (an entry must fit in one persist value)
+#define OFFLINE_QUEUE_TEXT_SIZE 248
+
+typedef struct {
+  uint32_t turn_id;  // Sent with the request, JS answers each turn only once
+  char text[OFFLINE_QUEUE_TEXT_SIZE];
+} QueuedTurn;
+
+/**
+ * Load the queue left over from the last time the app ran.
+ */
+void offline_queue_init(void);
+
+/**
+ * Get the number of queued turns.
+ * @return Number of turns
+ */
+int offline_queue_count(void);
+
+/**
+ * Get the conversation the queued turns belong to.
+ * @return Conversation id, only meaningful while turns are queued
+ */
+uint32_t offline_queue_conversation_id(void);
+
+/**
+ * Get the log index of the oldest queued turn.
+ * @return Index in the conversation log
+ */
+int offline_queue_first_index(void);
+
+/**
+ * Get the turn id of the oldest queued turn.
+ * @return Turn id, only meaningful while turns are queued
+ */
+uint32_t offline_queue_first_turn_id(void);
+
+/**
+ * Queue a question at the end of the conversation log.
+ * @param conversation_id Conversation the question belongs to, the queue is
+ *        cleared if it holds turns of another one
+ * @param log_index Index of the question in the conversation log
+ * @param text The question
+ * @param len Length of text to keep, less than OFFLINE_QUEUE_TEXT_SIZE
+ * @return The turn id, or 0 if the queue is full
+ */
+uint32_t offline_queue_push(uint32_t conversation_id, int log_index, const char *text, size_t len);
+
+/**
+ * Read a queued turn.
+ * @param position Position in the queue, 0 is the oldest
+ * @param turn Filled in with the turn
+ * @return false if there is no turn at that position
+ */
+bool offline_queue_peek(int position, QueuedTurn *turn);
+
+/**
+ * Drop the oldest turn once its answer has arrived.
+ * @param next_index Log index of the next turn (after the answer)
+ */
+void offline_queue_pop(int next_index);
+
+/**
+ * Drop all queued turns.
+ */
+void offline_queue_clear(void);
@@ -0,0 +1,126 @@
+#include "power_policy.h"
+#include "logging.h"
+
+// Persistent storage key for the power saving setting (1 and 2 are used by bit_ai.c)
+#define PERSIST_KEY_POWER_SAVING 3
+
+// Battery levels (percent, while not charging) at which the modes kick in
+#define SAVER_BATTERY_PERCENT 30
+#define CRITICAL_BATTERY_PERCENT 10
+
+#define MAX_HANDLERS 2
+
+// Per mode: spark frame duration multiplier, UI update interval, longest link hold
+static const uint8_t s_spark_slowdown[] = {
+  [POWER_MODE_NORMAL] = 1,
+  [POWER_MODE_SAVER] = 2,
+  [POWER_MODE_CRITICAL] = 1,  // Frozen, see power_policy_spark_frozen()
+};
+
+static const uint16_t s_ui_interval_ms[] = {
+  [POWER_MODE_NORMAL] = 33,
+  [POWER_MODE_SAVER] = 100,
+  [POWER_MODE_CRITICAL] = 250,
+};
+
+static const uint32_t s_link_hold_max_ms[] = {
+  [POWER_MODE_NORMAL] = 120000,
+  [POWER_MODE_SAVER] = 30000,
+  [POWER_MODE_CRITICAL] = 10000,
+};
+
+static PowerSaving s_saving = POWER_SAVING_AUTO;
+static BatteryChargeState s_battery;
+static PowerMode s_mode = POWER_MODE_NORMAL;
+static PowerModeHandler s_handlers[MAX_HANDLERS];
+
+static PowerMode mode_for_state(void) {
+  // Nothing to save while charging
+  if (s_saving == POWER_SAVING_NEVER || s_battery.is_charging || s_battery.is_plugged) {
+    return POWER_MODE_NORMAL;
+  }
+
+  if (s_battery.charge_percent <= CRITICAL_BATTERY_PERCENT) {
+    return POWER_MODE_CRITICAL;
+  }
+  if (s_battery.charge_percent <= SAVER_BATTERY_PERCENT || s_saving == POWER_SAVING_ALWAYS) {
+    return POWER_MODE_SAVER;
+  }
+  return POWER_MODE_NORMAL;
+}
+
+static void update_mode(void) {
+  PowerMode mode = mode_for_state();
+  if (mode == s_mode) {
+    return;
+  }
+
+  LOG_INFO("Power mode %d -> %d (battery %d%%)", s_mode, mode, s_battery.charge_percent);
+  s_mode = mode;
+
+  for (int i = 0; i < MAX_HANDLERS; i++) {
+    if (s_handlers[i]) {
+      s_handlers[i](mode);
+    }
+  }
+}
+
+static void battery_handler(BatteryChargeState state) {
+  s_battery = state;
+  update_mode();
+}
+
+void power_policy_init(void) {
+  if (persist_exists(PERSIST_KEY_POWER_SAVING)) {
+    s_saving = persist_read_int(PERSIST_KEY_POWER_SAVING);
+  }
+
+  s_battery = battery_state_service_peek();
+  s_mode = mode_for_state();
+  battery_state_service_subscribe(battery_handler);
+}
+
+void power_policy_deinit(void) {
+  battery_state_service_unsubscribe();
+  memset(s_handlers, 0, sizeof(s_handlers));
+}
+
+void power_policy_set_saving(PowerSaving saving) {
+  if (saving == s_saving) {
+    return;
+  }
+
+  s_saving = saving;
+  persist_write_int(PERSIST_KEY_POWER_SAVING, saving);
+  update_mode();
+}
+
+PowerMode power_policy_get_mode(void) {
+  return s_mode;
+}
+
+void power_policy_subscribe(PowerModeHandler handler) {
+  for (int i = 0; i < MAX_HANDLERS; i++) {
+    if (!s_handlers[i]) {
+      s_handlers[i] = handler;
+      return;
+    }
+  }
+  LOG_ERROR("Too many power mode handlers");
+}
+
+uint32_t power_policy_spark_frame_ms(uint32_t duration_ms) {
+  return duration_ms * s_spark_slowdown[s_mode];
+}
+
+bool power_policy_spark_frozen(void) {
+  return s_mode == POWER_MODE_CRITICAL;
+}
+
+uint32_t power_policy_ui_interval_ms(void) {
+  return s_ui_interval_ms[s_mode];
+}
+
+uint32_t power_policy_link_hold_max_ms(void) {
+  return s_link_hold_max_ms[s_mode];
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <pebble.h>
+
+/**
+ * Power Policy
+ *
+ * Picks a power mode from the battery state and the user's power saving
+ * setting, and turns it into the knobs the rest of the app uses: spark
+ * frame rate, how often UI updates are applied, and how long the
+ * Bluetooth link is kept in its fast mode around a request.
+ */
+
+typedef enum {
+  POWER_MODE_NORMAL,
+  POWER_MODE_SAVER,     // Low battery: slower spark, coarser UI updates
+  POWER_MODE_CRITICAL,  // Very low battery: spark frozen on a static frame
+} PowerMode;
+
+// User setting, sent by JS as POWER_SAVING (values must match index.js)
+typedef enum {
+  POWER_SAVING_AUTO = 0,    // Follow the battery level
+  POWER_SAVING_ALWAYS = 1,  // At least saver mode (normal while charging)
+  POWER_SAVING_NEVER = 2,   // Always normal mode
+} PowerSaving;
+
+typedef void (*PowerModeHandler)(PowerMode mode);
+
+/**
+ * Load the saved setting and start following the battery state.
+ */
+void power_policy_init(void);
+
+/**
+ * Stop following the battery state.
+ */
+void power_policy_deinit(void);
+
+/**
+ * Change and save the user's power saving setting.
+ * @param saving The new setting
+ */
+void power_policy_set_saving(PowerSaving saving);
+
+/**
+ * Get the current power mode.
+ * @return The power mode
+ */
+PowerMode power_policy_get_mode(void);
+
+/**
+ * Register a handler called when the power mode changes (up to 2 handlers).
+ * @param handler The handler
+ */
+void power_policy_subscribe(PowerModeHandler handler);
+
+/**
+ * Scale a spark frame duration for the current mode.
+ * @param duration_ms The frame duration at full rate
+ * @return The duration to wait before the next frame
+ */
+uint32_t power_policy_spark_frame_ms(uint32_t duration_ms);
+
+/**
+ * Whether the spark should stay on a static frame instead of animating.
+ * @return true if animation is off
+ */
+bool power_policy_spark_frozen(void);
+
+/**
+ * Minimum time between applying coalesced UI updates.
+ * @return Interval in milliseconds
+ */
+uint32_t power_policy_ui_interval_ms(void);
+
+/**
+ * Longest the Bluetooth link may stay in its fast mode waiting for an
+ * answer that doesn't come (see link_mode.h).
+ * @return Duration in milliseconds
+ */
+uint32_t power_policy_link_hold_max_ms(void);
@@ -0,0 +1,87 @@
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+
+typedef struct {
+  uint32_t count;
+  uint32_t total_ms;
+  uint16_t min_ms;
+  uint16_t max_ms;
+} ProfileStats;
+
+// Names used in the log, keep in the order of ProfilePoint
+static const char *s_point_names[PROFILE_POINT_COUNT] = {
+  [PROFILE_REBUILD_CONTENT] = "rebuild_content",
+  [PROFILE_LAYOUT_SLICE] = "layout_slice",
+  [PROFILE_BUBBLE_CREATE] = "bubble_create",
+  [PROFILE_BUBBLE_RESET] = "bubble_reset",
+  [PROFILE_SPARK_DRAW] = "spark_draw",
+  [PROFILE_UI_UPDATE] = "ui_update",
+  [PROFILE_HANDLE_INBOX] = "handle_inbox",
+  [PROFILE_INBOX_RECEIVED] = "inbox_received",
+  [PROFILE_INBOX_DROPPED] = "inbox_dropped",
+  [PROFILE_OUTBOX_SENT] = "outbox_sent",
+  [PROFILE_OUTBOX_FAILED] = "outbox_failed",
+  [PROFILE_TURN_LATENCY] = "turn_latency",
+  [PROFILE_PAGE_LATENCY] = "page_latency",
+  [PROFILE_FAST_LINK] = "fast_link",
+};
+
+static ProfileStats s_stats[PROFILE_POINT_COUNT];
+
+// Start times of running spans, 0 when none is running
+static uint32_t s_span_start[PROFILE_POINT_COUNT];
+
+uint32_t profiler_now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+void profiler_record(ProfilePoint point, uint32_t duration_ms) {
+  ProfileStats *stats = &s_stats[point];
+  uint16_t duration = duration_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)duration_ms;
+
+  if (stats->count == 0 || duration < stats->min_ms) {
+    stats->min_ms = duration;
+  }
+  if (duration > stats->max_ms) {
+    stats->max_ms = duration;
+  }
+  stats->count++;
+  stats->total_ms += duration;
+}
+
+void profiler_span_begin(ProfilePoint point) {
+  s_span_start[point] = profiler_now_ms();
+  if (s_span_start[point] == 0) {
+    s_span_start[point] = 1;
+  }
+}
+
+void profiler_span_end(ProfilePoint point) {
+  if (s_span_start[point] == 0) {
+    return;
+  }
+
+  profiler_record(point, profiler_now_ms() - s_span_start[point]);
+  s_span_start[point] = 0;
+}
+
+void profiler_dump(void) {
+  for (int i = 0; i < PROFILE_POINT_COUNT; i++) {
+    ProfileStats *stats = &s_stats[i];
+    if (stats->count == 0) {
+      continue;
+    }
+
+    // Average in hundredths of a millisecond, most samples are under the 1 ms resolution
+    uint32_t avg_centi_ms = stats->total_ms * 100 / stats->count;
+    APP_LOG(APP_LOG_LEVEL_INFO, "PROF point=%s count=%lu min=%u avg=%lu.%02lu max=%u",
+            s_point_names[i], (unsigned long)stats->count, stats->min_ms,
+            (unsigned long)(avg_centi_ms / 100), (unsigned long)(avg_centi_ms % 100), stats->max_ms);
+  }
+}
+
+#endif
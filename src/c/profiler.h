@@ -0,0 +1,82 @@
+#pragma once
+#include <pebble.h>
+
+/**
+ * Profiler
+ *
+ * Timing of the UI and messaging hot paths, compiled in only when
+ * PROFILER_ENABLED is defined (set BIT_AI_PROFILER=1 when building). Each
+ * point keeps count/min/max/total in a fixed table, and profiler_dump()
+ * logs one "PROF" line per point for tools/profile_report.js. Spans time
+ * something that starts in one callback and ends in another (one span per
+ * point at a time). With the profiler off the macros expand to nothing.
+ */
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 0
+#endif
+
+typedef enum {
+  PROFILE_REBUILD_CONTENT,
+  PROFILE_LAYOUT_SLICE,
+  PROFILE_BUBBLE_CREATE,
+  PROFILE_BUBBLE_RESET,
+  PROFILE_SPARK_DRAW,
+  PROFILE_UI_UPDATE,
+  PROFILE_HANDLE_INBOX,
+  PROFILE_INBOX_RECEIVED,
+  PROFILE_INBOX_DROPPED,
+  PROFILE_OUTBOX_SENT,
+  PROFILE_OUTBOX_FAILED,
+  PROFILE_TURN_LATENCY,  // Span: REQUEST_CHAT sent to answer received
+  PROFILE_PAGE_LATENCY,  // Span: REQUEST_PAGE sent to page received
+  PROFILE_FAST_LINK,     // Span: time spent on the reduced sniff interval
+  PROFILE_POINT_COUNT
+} ProfilePoint;
+
+#if PROFILER_ENABLED
+
+/**
+ * Current time in milliseconds (wraps, only differences are meaningful).
+ */
+uint32_t profiler_now_ms(void);
+
+/**
+ * Add one sample to a profile point.
+ * @param point The profile point
+ * @param duration_ms Measured duration
+ */
+void profiler_record(ProfilePoint point, uint32_t duration_ms);
+
+/**
+ * Start a span, replacing one already running for the point.
+ * @param point The profile point
+ */
+void profiler_span_begin(ProfilePoint point);
+
+/**
+ * End the running span of a point and add its duration as a sample.
+ * @param point The profile point
+ */
+void profiler_span_end(ProfilePoint point);
+
+/**
+ * Log the aggregated samples of every point that has any.
+ */
+void profiler_dump(void);
+
+#define PROFILE_BEGIN(point) uint32_t profile_start_##point = profiler_now_ms()
+#define PROFILE_END(point) profiler_record(point, profiler_now_ms() - profile_start_##point)
+#define PROFILE_SPAN_BEGIN(point) profiler_span_begin(point)
+#define PROFILE_SPAN_END(point) profiler_span_end(point)
+#define PROFILE_DUMP() profiler_dump()
+
+#else
+
+#define PROFILE_BEGIN(point)
+#define PROFILE_END(point)
+#define PROFILE_SPAN_BEGIN(point)
+#define PROFILE_SPAN_END(point)
+#define PROFILE_DUMP()
+
+#endif
@@ -0,0 +1,67 @@
+#include "resume_wakeup.h"
+#include "logging.h"
+#include "offline_queue.h"
+
+// Persistent storage key for the setting (1-8 are used by bit_ai.c, power_policy.c
+// and offline_queue.c)
+#define PERSIST_KEY_RESUME_WAKEUP 9
+
+// Time from closing to the relaunch, long enough for the user to get on with
+// what they left for
+#define WAKEUP_DELAY_S 60
+
+// The system refuses wakeups within a minute of another app's, later slots are tried
+#define WAKEUP_ATTEMPTS 3
+#define WAKEUP_SLOT_S 60
+
+static bool s_woken_up;
+static bool s_enabled;
+
+void resume_wakeup_init(void) {
+  s_enabled = persist_read_bool(PERSIST_KEY_RESUME_WAKEUP);
+  s_woken_up = (launch_reason() == APP_LAUNCH_WAKEUP);
+  wakeup_cancel_all();
+
+  if (s_woken_up) {
+    LOG_INFO("Woken up for %d queued questions", offline_queue_count());
+  }
+}
+
+void resume_wakeup_set_enabled(bool enabled) {
+  if (enabled == s_enabled) {
+    return;
+  }
+
+  s_enabled = enabled;
+  persist_write_bool(PERSIST_KEY_RESUME_WAKEUP, enabled);
+}
+
+void resume_wakeup_schedule(void) {
+  if (!s_enabled || offline_queue_count() == 0 || !connection_service_peek_pebble_app_connection()) {
+    return;
+  }
+
+  time_t when = time(NULL) + WAKEUP_DELAY_S;
+  for (int i = 0; i < WAKEUP_ATTEMPTS; i++) {
+    WakeupId id = wakeup_schedule(when + i * WAKEUP_SLOT_S, 0, false);
+    if (id >= 0) {
+      LOG_INFO("Wakeup in %d s for %d queued questions",
+               WAKEUP_DELAY_S + i * WAKEUP_SLOT_S, offline_queue_count());
+      return;
+    }
+    if (id != E_RANGE) {
+      break;
+    }
+  }
+  LOG_WARNING("No wakeup for the queued questions");
+}
+
+void resume_wakeup_answered(void) {
+  if (!s_woken_up) {
+    return;
+  }
+
+  // Once, later questions are asked with the app in front of the user
+  s_woken_up = false;
+  vibes_short_pulse();
+}
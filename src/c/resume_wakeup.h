@@ -0,0 +1,38 @@
+#pragma once
+#include <pebble.h>
+
+/**
+ * Resume Wakeup
+ *
+ * Finishes questions that were still unanswered when the app closed, if the
+ * user opted in. A background worker can't do it: workers have no
+ * AppMessage, so they never see the answer. Instead the app schedules a
+ * wakeup for itself on the way out, which brings it back to the foreground.
+ * PebbleKit JS stops with the app, so the request in flight is lost: the
+ * queued turn goes out again with the same turn id and is normally asked
+ * again (the phone's log only has the answer if it came in before the app
+ * closed). The watch vibrates once the queue is answered.
+ */
+
+/**
+ * Cancel the wakeup left from the last time the app closed and note whether
+ * it is what launched the app.
+ */
+void resume_wakeup_init(void);
+
+/**
+ * Turn the wakeup on or off and save the setting. Off by default.
+ * @param enabled true to reopen the app for unanswered questions
+ */
+void resume_wakeup_set_enabled(bool enabled);
+
+/**
+ * Schedule a wakeup if it's enabled, questions are still queued and the phone
+ * is there to answer them.
+ */
+void resume_wakeup_schedule(void);
+
+/**
+ * The queued questions are all answered: vibrate if the app was woken up for them.
+ */
+void resume_wakeup_answered(void);
@@ -0,0 +1,108 @@
+// Per-provider circuit breaker. After repeated failures the circuit opens and
+// requests to that endpoint fail fast for a cooldown period; once it expires
+// a single trial request is let through (half-open) to probe for recovery.
+
+var log = require('./log');
+
+var FAILURE_THRESHOLD = 3;
+var BASE_COOLDOWN_MS = 30000;
+var MAX_COOLDOWN_MS = 300000;
+
+// States, also the values reported to the watch in PROVIDER_STATUS
+var CLOSED = 0;
+var HALF_OPEN = 1;
+var OPEN = 2;
+
+var circuits = {};
+var listener = null;
+
+function get(key) {
+  if (!circuits[key]) {
+    circuits[key] = { state: CLOSED, failures: 0, openedAt: 0, cooldown: BASE_COOLDOWN_MS, trialInFlight: false };
+  }
+  return circuits[key];
+}
+
+function setState(key, circuit, state) {
+  if (circuit.state !== state) {
+    log.info('Circuit ' + key + ': ' + circuit.state + ' -> ' + state);
+    circuit.state = state;
+    if (listener) {
+      listener(key, state);
+    }
+  }
+}
+
+// Check whether a request to the endpoint may go out now
+function allowRequest(key) {
+  var circuit = get(key);
+
+  if (circuit.state === OPEN) {
+    if (Date.now() - circuit.openedAt < circuit.cooldown) {
+      return false;
+    }
+    setState(key, circuit, HALF_OPEN);
+  }
+
+  if (circuit.state === HALF_OPEN) {
+    // Only one trial request at a time while probing
+    if (circuit.trialInFlight) {
+      return false;
+    }
+    circuit.trialInFlight = true;
+  }
+
+  return true;
+}
+
+function recordSuccess(key) {
+  var circuit = get(key);
+  circuit.failures = 0;
+  circuit.cooldown = BASE_COOLDOWN_MS;
+  circuit.trialInFlight = false;
+  setState(key, circuit, CLOSED);
+}
+
+function recordFailure(key) {
+  var circuit = get(key);
+  circuit.failures++;
+
+  if (circuit.state === HALF_OPEN) {
+    // Trial failed, back off for longer before probing again
+    circuit.trialInFlight = false;
+    circuit.cooldown = Math.min(MAX_COOLDOWN_MS, circuit.cooldown * 2);
+    circuit.openedAt = Date.now();
+    setState(key, circuit, OPEN);
+  } else if (circuit.failures >= FAILURE_THRESHOLD) {
+    circuit.openedAt = Date.now();
+    setState(key, circuit, OPEN);
+  }
+}
+
+// Release the trial slot of a request that was abandoned before it finished
+function abandon(key) {
+  get(key).trialInFlight = false;
+}
+
+// Milliseconds until an open circuit lets a trial request through
+function retryIn(key) {
+  var circuit = get(key);
+  return Math.max(0, circuit.cooldown - (Date.now() - circuit.openedAt));
+}
+
+// Register a callback(key, state) for state changes
+function onStateChange(callback) {
+  listener = callback;
+}
+
+module.exports = {
+  CLOSED: CLOSED,
+  HALF_OPEN: HALF_OPEN,
+  OPEN: OPEN,
+  allowRequest: allowRequest,
+  recordSuccess: recordSuccess,
+  recordFailure: recordFailure,
+  abandon: abandon,
+  retryIn: retryIn,
+  onStateChange: onStateChange
+};
@@ -0,0 +1,102 @@
+// Decoding of the conversation the watch sends in REQUEST_CHAT. It arrives as
+// a byte array of frames, one per message: a role byte, a little-endian
+// 16-bit length, then that many bytes of UTF-8 text. Paged responses (see
+// pager.js) have a 16-bit response id ahead of the text the watch still has.
+// Must match send_chat_request() in chat_window.c.
+
+var log = require('./log');
+
+var ROLE_USER = 0;
+var ROLE_ASSISTANT = 1;
+var ROLE_PAGED_ASSISTANT = 2;
+var FRAME_HEADER_SIZE = 3;
+
+// Decode bytes[start, end) as UTF-8. Invalid sequences become U+FFFD.
+function decodeUtf8(bytes, start, end) {
+  var codes = [];
+  var i = start;
+
+  while (i < end) {
+    var b = bytes[i++];
+    var extra = 0;
+    var code;
+
+    if (b < 0x80) {
+      code = b;
+    } else if (b >= 0xC2 && b < 0xE0) {
+      code = b & 0x1F;
+      extra = 1;
+    } else if (b >= 0xE0 && b < 0xF0) {
+      code = b & 0x0F;
+      extra = 2;
+    } else if (b >= 0xF0 && b < 0xF5) {
+      code = b & 0x07;
+      extra = 3;
+    } else {
+      codes.push(0xFFFD);
+      continue;
+    }
+
+    while (extra > 0 && i < end && (bytes[i] & 0xC0) === 0x80) {
+      code = (code << 6) | (bytes[i++] & 0x3F);
+      extra--;
+    }
+
+    if (extra > 0) {
+      codes.push(0xFFFD);
+    } else if (code > 0xFFFF) {
+      // Outside the BMP, split into a surrogate pair
+      code -= 0x10000;
+      codes.push(0xD800 + (code >> 10), 0xDC00 + (code & 0x3FF));
+    } else {
+      codes.push(code);
+    }
+  }
+
+  var text = '';
+  for (var c = 0; c < codes.length; c += 4096) {
+    text += String.fromCharCode.apply(null, codes.slice(c, c + 4096));
+  }
+  return text;
+}
+
+// Turn the REQUEST_CHAT byte array into [{role, content}]. A truncated
+// trailing frame is ignored. fullText(id) returns the whole text of a paged
+// response, or null to fall back to the part the watch sent.
+function decodeConversation(bytes, fullText) {
+  var messages = [];
+  var offset = 0;
+
+  while (offset + FRAME_HEADER_SIZE <= bytes.length) {
+    var role = bytes[offset];
+    var length = bytes[offset + 1] | (bytes[offset + 2] << 8);
+    var start = offset + FRAME_HEADER_SIZE;
+    var end = start + length;
+
+    if (end > bytes.length) {
+      log.warn('Truncated conversation frame at byte ' + offset);
+      break;
+    }
+
+    if (role === ROLE_PAGED_ASSISTANT && length >= 2) {
+      var id = bytes[start] | (bytes[start + 1] << 8);
+      messages.push({
+        role: 'assistant',
+        content: (fullText && fullText(id)) || decodeUtf8(bytes, start + 2, end)
+      });
+    } else if (length > 0 && (role === ROLE_USER || role === ROLE_ASSISTANT)) {
+      messages.push({
+        role: role === ROLE_USER ? 'user' : 'assistant',
+        content: decodeUtf8(bytes, start, end)
+      });
+    }
+
+    offset = end;
+  }
+
+  return messages;
+}
+
+module.exports = {
+  decodeConversation: decodeConversation
+};
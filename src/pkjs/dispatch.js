@@ -0,0 +1,226 @@
+// Batched AppMessage dispatch. Every Pebble.sendAppMessage() call is its own
+// Bluetooth transaction with an ack round trip and a watch wakeup, so updates
+// are queued here and coalesced into as few dictionaries as possible:
+// - keys that aren't already pending are merged into the pending dictionary
+// - state keys already pending are overwritten with the newer value
+// - text keys already pending are appended to
+// Only one message is in flight at a time; whatever queues up meanwhile goes
+// out together once the previous one is acked.
+
+var log = require('./log');
+
+// Must match the inbox size passed to app_message_open() on the watch
+// (APP_MESSAGE_INBOX_SIZE in build_profile.h), see setPlatform()
+var MAX_PAYLOAD_BYTES = 4096;
+var LEAN_MAX_PAYLOAD_BYTES = 1024;
+
+// How long to wait for more updates before sending a new dictionary
+var COALESCE_WINDOW_MS = 30;
+
+// Failed sends are retried this many times before the update is dropped
+var MAX_SEND_RETRIES = 2;
+var RETRY_DELAY_MS = 100;
+
+// Keys whose pending text is appended to rather than replaced
+var APPEND_KEYS = ['RESPONSE_TEXT'];
+
+// Keys that close a dictionary: nothing queued later is merged into it, so
+// the watch always sees them after every update they follow. Each response
+// page, history message and conversation menu row goes out on its own so
+// its text isn't appended to (or its fields overwritten by) the next one.
+var BARRIER_KEYS = ['RESPONSE_END', 'RESPONSE_ID', 'HISTORY_INDEX', 'CONVERSATION_INDEX'];
+
+var queue = [];
+var inFlight = false;
+var windowTimer = null;
+var turn = null;
+
+// UTF-8 encoded length of a string
+function utf8Length(str) {
+  return unescape(encodeURIComponent(str)).length;
+}
+
+// Approximate serialized size of a value in a dictionary tuple
+function valueSize(value) {
+  if (typeof value === 'string') {
+    return utf8Length(value) + 1;
+  }
+  if (value instanceof Array) {
+    return value.length;
+  }
+  return 4;
+}
+
+// Approximate serialized size of a dictionary: a count byte, then a 7-byte
+// header (key, type, length) per tuple followed by its value
+function dictSize(dict) {
+  var size = 1;
+  for (var key in dict) {
+    size += 7 + valueSize(dict[key]);
+  }
+  return size;
+}
+
+function isAppend(key, a, b) {
+  return APPEND_KEYS.indexOf(key) !== -1 && typeof a === 'string' && typeof b === 'string';
+}
+
+// Try to merge an update into a queued dictionary, returns false if it doesn't fit
+function merge(frame, dict) {
+  if (frame.sealed) {
+    return false;
+  }
+
+  var merged = {};
+  var key;
+  for (key in frame.dict) {
+    merged[key] = frame.dict[key];
+  }
+  for (key in dict) {
+    merged[key] = (key in merged && isAppend(key, merged[key], dict[key])) ? merged[key] + dict[key] : dict[key];
+  }
+
+  if (dictSize(merged) > MAX_PAYLOAD_BYTES) {
+    return false;
+  }
+
+  frame.dict = merged;
+  frame.updates++;
+  return true;
+}
+
+function hasBarrier(dict) {
+  for (var i = 0; i < BARRIER_KEYS.length; i++) {
+    if (BARRIER_KEYS[i] in dict) {
+      return true;
+    }
+  }
+  return false;
+}
+
+function sendNext() {
+  windowTimer = null;
+  if (inFlight || queue.length === 0) {
+    return;
+  }
+
+  var frame = queue.shift();
+  inFlight = true;
+
+  Pebble.sendAppMessage(frame.dict, function () {
+    inFlight = false;
+    delivered(frame);
+    sendNext();
+  }, function (e) {
+    inFlight = false;
+
+    if (frame.retries < MAX_SEND_RETRIES) {
+      frame.retries++;
+      log.warn('AppMessage failed, retrying (' + frame.retries + '/' + MAX_SEND_RETRIES + ')');
+      queue.unshift(frame);
+      setTimeout(sendNext, RETRY_DELAY_MS);
+    } else {
+      log.error('AppMessage failed, dropping ' + Object.keys(frame.dict).join(', ') + ': ' + (e && e.error && e.error.message));
+      sendNext();
+    }
+  });
+}
+
+// Count a delivered dictionary against the current turn
+function delivered(frame) {
+  if (!turn) {
+    return;
+  }
+
+  turn.messages++;
+  turn.updates += frame.updates;
+
+  if (hasBarrier(frame.dict)) {
+    log.info('Turn delivered in ' + turn.messages + ' AppMessages for ' + turn.updates + ' updates');
+    turn = null;
+  }
+}
+
+// Shorten the longest string values of a dictionary until it fits the inbox,
+// a message that doesn't fit would be dropped by the watch entirely
+function truncateToFit(dict) {
+  var excess = dictSize(dict) - MAX_PAYLOAD_BYTES;
+  if (excess <= 0) {
+    return dict;
+  }
+
+  var longest = null;
+  for (var key in dict) {
+    if (typeof dict[key] === 'string' && (!longest || dict[key].length > dict[longest].length)) {
+      longest = key;
+    }
+  }
+
+  if (!longest) {
+    return dict;
+  }
+
+  // Find the longest prefix whose UTF-8 size fits, leaving room for an ellipsis
+  var text = dict[longest];
+  var budget = utf8Length(text) - excess - 3;
+  var low = 0;
+  var high = text.length;
+  while (low < high) {
+    var mid = Math.ceil((low + high) / 2);
+    if (utf8Length(text.substring(0, mid)) <= budget) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  var keep = low;
+
+  log.warn('Truncating ' + longest + ' from ' + text.length + ' to ' + keep + ' characters to fit the inbox');
+  dict[longest] = text.substring(0, keep) + '...';
+  return dict;
+}
+
+// Queue an update for the watch
+function send(dict) {
+  dict = truncateToFit(dict);
+
+  var last = queue[queue.length - 1];
+
+  if (!last || !merge(last, dict)) {
+    last = { dict: dict, updates: 1, retries: 0, sealed: false };
+    queue.push(last);
+  }
+
+  if (hasBarrier(dict)) {
+    last.sealed = true;
+  }
+
+  if (inFlight) {
+    // Goes out as soon as the current message is acked
+    return;
+  }
+
+  if (last.sealed) {
+    // Nothing can be merged into it anymore, no reason to wait
+    clearTimeout(windowTimer);
+    sendNext();
+  } else if (!windowTimer) {
+    windowTimer = setTimeout(sendNext, COALESCE_WINDOW_MS);
+  }
+}
+
+// Start counting messages for a new request/response turn
+function beginTurn() {
+  turn = { messages: 0, updates: 0 };
+}
+
+// Size messages for the connected watch's inbox
+function setPlatform(platform) {
+  MAX_PAYLOAD_BYTES = platform === 'aplite' ? LEAN_MAX_PAYLOAD_BYTES : 4096;
+}
+
+module.exports = {
+  setPlatform: setPlatform,
+  send: send,
+  beginTurn: beginTurn
+};
@@ -0,0 +1,213 @@
+// The conversations, each a full log of its messages. The watch only keeps a
+// window of the open conversation in memory and fetches older (or newer)
+// messages from here as the user scrolls, and browses the others through a
+// compact index. Kept in local storage so scrollback survives the phone
+// restarting the JS runtime.
+
+var INDEX_KEY = 'conversation_index';
+var LOG_KEY_PREFIX = 'conversation_log_';
+
+// Where the single log of earlier versions was kept, moved into the index on first use
+var LEGACY_KEY = 'conversation_log';
+
+// Oldest messages are dropped past this, the watch is told they're gone
+var MAX_ENTRIES = 200;
+
+// Least recently updated conversations are deleted past this
+var MAX_CONVERSATIONS = 20;
+
+// Titles are the start of the first question
+var TITLE_LENGTH = 40;
+
+// Context sent to the provider reaches at least this far back, even when
+// the watch's window is shorter
+var MIN_CONTEXT_MESSAGES = 10;
+
+// [{ id, title, updated, length }], most recently updated first. updated is
+// in seconds, length is the number of messages the conversation has had.
+var index = null;
+
+// { id, start, entries: [{ role, content, responseId, turnId }] }, entries[0]
+// is message number start of the conversation. User messages the watch asked
+// to have answered carry its turn id. Only the log last used is loaded.
+var log = null;
+
+function loadIndex() {
+  if (!index) {
+    try {
+      index = JSON.parse(localStorage.getItem(INDEX_KEY));
+    } catch (e) {
+      index = null;
+    }
+    index = index || [];
+
+    var legacy = localStorage.getItem(LEGACY_KEY);
+    if (legacy) {
+      localStorage.removeItem(LEGACY_KEY);
+      try {
+        log = JSON.parse(legacy);
+      } catch (e) {
+        log = null;
+      }
+      if (log && log.entries.length > 0) {
+        save();
+      }
+    }
+  }
+  return index;
+}
+
+function findIndex(conversationId) {
+  var list = loadIndex();
+  for (var i = 0; i < list.length; i++) {
+    if (list[i].id === conversationId) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// The log of a conversation, or null if there is no such conversation
+function load(conversationId) {
+  loadIndex();
+  if (!log || log.id !== conversationId) {
+    try {
+      log = JSON.parse(localStorage.getItem(LOG_KEY_PREFIX + conversationId));
+    } catch (e) {
+      log = null;
+    }
+  }
+  return log && log.id === conversationId ? log : null;
+}
+
+function titleOf(entries) {
+  for (var i = 0; i < entries.length; i++) {
+    if (entries[i].role === 'user') {
+      var title = entries[i].content.replace(/\s+/g, ' ').trim();
+      return title.length > TITLE_LENGTH ? title.substring(0, TITLE_LENGTH - 1).trim() + '…' : title;
+    }
+  }
+  return '';
+}
+
+// Write the open log and move it to the top of the index
+function save() {
+  while (log.entries.length > MAX_ENTRIES) {
+    log.entries.shift();
+    log.start++;
+  }
+  localStorage.setItem(LOG_KEY_PREFIX + log.id, JSON.stringify(log));
+
+  var position = findIndex(log.id);
+  var item = position >= 0 ? index.splice(position, 1)[0] : { id: log.id, title: '' };
+  item.title = item.title || titleOf(log.entries);
+  item.updated = Math.floor(Date.now() / 1000);
+  item.length = end();
+  index.unshift(item);
+
+  while (index.length > MAX_CONVERSATIONS) {
+    localStorage.removeItem(LOG_KEY_PREFIX + index.pop().id);
+  }
+  localStorage.setItem(INDEX_KEY, JSON.stringify(index));
+}
+
+function end() {
+  return log.start + log.entries.length;
+}
+
+function entry(position) {
+  return (position >= log.start && position < end()) ? log.entries[position - log.start] : null;
+}
+
+// Message number position of the conversation, or null if it isn't in the log
+function get(conversationId, position) {
+  return load(conversationId) ? entry(position) : null;
+}
+
+// Merge the window the watch sent (starting at log index base) into the log
+// and return the messages to send to the provider. Messages already in the
+// log keep their full text, the watch may only have part of them. turnId
+// is recorded on the last message, the question to answer.
+function merge(conversationId, base, messages, turnId) {
+  if (!load(conversationId) || base > end()) {
+    // New conversation, or one this log has lost track of
+    log = { id: conversationId, start: base, entries: [] };
+  } else if (base < log.start) {
+    // Older than what's kept, the watch's copy is all there is
+    messages = messages.slice(log.start - base);
+    base = log.start;
+  }
+
+  for (var i = 0; i < messages.length; i++) {
+    var position = base + i;
+    var existing = entry(position);
+
+    if (existing && existing.role === messages[i].role) {
+      continue;
+    }
+
+    // Diverged from the log (or past its end), the watch's version wins
+    log.entries.length = position - log.start;
+    log.entries.push({ role: messages[i].role, content: messages[i].content });
+  }
+
+  var last = entry(base + messages.length - 1);
+  if (turnId && last && last.role === 'user') {
+    last.turnId = turnId;
+  }
+  save();
+
+  // Context: the watch's window, extended back to MIN_CONTEXT_MESSAGES and
+  // starting with a user turn
+  var from = Math.max(log.start, Math.min(base, end() - MIN_CONTEXT_MESSAGES));
+  while (from < end() - 1 && log.entries[from - log.start].role !== 'user') {
+    from++;
+  }
+
+  return log.entries.slice(from - log.start).map(function (entry) {
+    return { role: entry.role, content: entry.content };
+  });
+}
+
+// The answer already given to the question with turnId, or null if it
+// hasn't been answered
+function answer(conversationId, turnId) {
+  if (!load(conversationId)) {
+    return null;
+  }
+
+  for (var i = 0; i < log.entries.length - 1; i++) {
+    if (log.entries[i].turnId === turnId && log.entries[i + 1].role === 'assistant') {
+      return log.entries[i + 1].content;
+    }
+  }
+  return null;
+}
+
+// Record the assistant's answer at the end of a conversation
+function append(conversationId, role, content, responseId) {
+  if (!load(conversationId)) {
+    return;
+  }
+  log.entries.push({ role: role, content: content, responseId: responseId });
+  save();
+}
+
+// Index entries from position start on, at most count of them
+function list(start, count) {
+  return loadIndex().slice(start, start + count);
+}
+
+// Number of conversations in the index
+function count() {
+  return loadIndex().length;
+}
+
+module.exports = {
+  get: get,
+  merge: merge,
+  answer: answer,
+  append: append,
+  list: list,
+  count: count
+};
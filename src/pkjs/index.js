@@ -1,119 +1,268 @@
-// Parse encoded conversation string "[U]msg1[A]msg2..." into messages array
-function parseConversation(encoded) {
-  var messages = [];
-  var parts = encoded.split(/(\[U\]|\[A\])/);
-
-  var currentRole = null;
-  for (var i = 0; i < parts.length; i++) {
-    if (parts[i] === '[U]') {
-      currentRole = 'user';
-    } else if (parts[i] === '[A]') {
-      currentRole = 'assistant';
-    } else if (parts[i] && parts[i].length > 0 && currentRole) {
-      messages.push({
-        role: currentRole,
-        content: parts[i]
-      });
-      currentRole = null;
+var latency = require('./latency');
+var circuit = require('./circuit');
+var dispatch = require('./dispatch');
+var conversation = require('./conversation');
+var pager = require('./pager');
+var history = require('./history');
+var probe = require('./probe');
+var log = require('./log');
+
+// Read settings from local storage, filling in provider-specific defaults.
+// The prefix selects the primary ('') or secondary ('secondary_') provider.
+function loadSettings(prefix) {
+  prefix = prefix || '';
+
+  var settings = {
+    provider: localStorage.getItem(prefix + 'provider') || 'claude',
+    providerName: localStorage.getItem('provider_name') || 'AI',
+    apiKey: localStorage.getItem(prefix + 'api_key'),
+    baseUrl: localStorage.getItem(prefix + 'base_url'),
+    model: localStorage.getItem(prefix + 'model'),
+    systemMessage: localStorage.getItem('system_message') || "You're running on a Pebble smartwatch. Please respond in plain text without any formatting, keeping your responses within 1-3 sentences.",
+    webSearchEnabled: localStorage.getItem('web_search_enabled') === 'true'
+  };
+
+  // Set provider-specific defaults if not configured
+  if (!settings.baseUrl) {
+    if (settings.provider === 'claude') settings.baseUrl = 'https://api.anthropic.com/v1/messages';
+    else if (settings.provider === 'openai') settings.baseUrl = 'https://api.openai.com/v1/chat/completions';
+    else if (settings.provider === 'openrouter') settings.baseUrl = 'https://openrouter.ai/api/v1/chat/completions';
+    else if (settings.provider === 'grok') settings.baseUrl = 'https://api.x.ai/v1/chat/completions';
+  }
+
+  if (!settings.model) {
+    if (settings.provider === 'claude') settings.model = 'claude-haiku-4-5';
+    else if (settings.provider === 'openai') settings.model = 'gpt-4o-mini';
+    else if (settings.provider === 'openrouter') settings.model = 'anthropic/claude-3.5-haiku';
+    else if (settings.provider === 'grok') settings.model = 'grok-2-latest';
+  }
+
+  return settings;
+}
+
+// Cached request templates (headers and body fields that don't depend on the conversation)
+var requestTemplates = {};
+
+// Build the request headers and body template from settings
+function buildRequestTemplate(settings) {
+  var headers = { 'Content-Type': 'application/json' };
+
+  // Set provider-specific headers
+  if (settings.provider === 'claude') {
+    headers['x-api-key'] = settings.apiKey;
+    headers['anthropic-version'] = '2023-06-01';
+  } else if (settings.provider === 'openrouter') {
+    headers['Authorization'] = 'Bearer ' + settings.apiKey;
+    headers['HTTP-Referer'] = 'https://github.com/breitburg/claude-for-pebble';
+  } else {
+    // OpenAI, Grok, and custom endpoints use Bearer token
+    headers['Authorization'] = 'Bearer ' + settings.apiKey;
+  }
+
+  var body = {
+    model: settings.model,
+    max_tokens: 256
+  };
+
+  // Provider-specific request body modifications
+  if (settings.provider === 'claude') {
+    // Claude uses 'system' field separately
+    if (settings.systemMessage) {
+      body.system = settings.systemMessage;
+    }
+
+    // Add web search tool if enabled (Claude only)
+    if (settings.webSearchEnabled) {
+      body.tools = [{
+        type: 'web_search_20250305',
+        name: 'web_search',
+        max_uses: 5
+      }];
     }
   }
 
-  return messages;
+  return {
+    settings: settings,
+    latencyKey: latency.keyFor(settings),
+    circuitKey: settings.provider + '|' + settings.baseUrl,
+    headers: headers,
+    body: body
+  };
 }
 
-// Get response from AI API
-function getAIResponse(messages) {
-  var provider = localStorage.getItem('provider') || 'claude';
-  var providerName = localStorage.getItem('provider_name') || 'AI';
-  var apiKey = localStorage.getItem('api_key');
-  var baseUrl = localStorage.getItem('base_url');
-  var model = localStorage.getItem('model');
-  var systemMessage = localStorage.getItem('system_message') || "You're running on a Pebble smartwatch. Please respond in plain text without any formatting, keeping your responses within 1-3 sentences.";
-  var webSearchEnabled = localStorage.getItem('web_search_enabled') === 'true';
+// Get the cached request template, building it on first use. The primary
+// provider answers with the model picked from the latency probes, if enabled.
+function getRequestTemplate(prefix) {
+  prefix = prefix || '';
+  if (!requestTemplates[prefix]) {
+    var settings = loadSettings(prefix);
+    if (!prefix) {
+      settings.model = probe.pick(settings.model);
+    }
+    requestTemplates[prefix] = buildRequestTemplate(settings);
+  }
+  return requestTemplates[prefix];
+}
 
-  // Set provider-specific defaults if not configured
-  if (!baseUrl) {
-    if (provider === 'claude') baseUrl = 'https://api.anthropic.com/v1/messages';
-    else if (provider === 'openai') baseUrl = 'https://api.openai.com/v1/chat/completions';
-    else if (provider === 'openrouter') baseUrl = 'https://openrouter.ai/api/v1/chat/completions';
-    else if (provider === 'grok') baseUrl = 'https://api.x.ai/v1/chat/completions';
+// Template for the primary provider with another model, for latency probes
+function getModelTemplate(model) {
+  var settings = loadSettings();
+  settings.model = model;
+  settings.webSearchEnabled = false;
+  return buildRequestTemplate(settings);
+}
+
+// Get the secondary provider's template, or null if none is configured
+function getSecondaryTemplate() {
+  if (!localStorage.getItem('secondary_api_key')) {
+    return null;
   }
+  return getRequestTemplate('secondary_');
+}
+
+// Minimum time between warm-up requests to the same host
+var WARM_UP_INTERVAL_MS = 30000;
+var lastWarmUp = {};
 
-  if (!model) {
-    if (provider === 'claude') model = 'claude-haiku-4-5';
-    else if (provider === 'openai') model = 'gpt-4o-mini';
-    else if (provider === 'openrouter') model = 'anthropic/claude-3.5-haiku';
-    else if (provider === 'grok') model = 'grok-2-latest';
+// Open a connection to the provider host ahead of the real request, so DNS,
+// TCP and TLS setup happen while the user is still dictating
+function warmUpConnection(template) {
+  var settings = template.settings;
+
+  if (!settings.apiKey || !settings.baseUrl) {
+    return;
   }
 
-  if (!apiKey) {
-    console.log('No API key configured');
-    Pebble.sendAppMessage({ 'RESPONSE_TEXT': 'No API key configured. Please configure in settings.' });
-    Pebble.sendAppMessage({ 'RESPONSE_END': 1 });
+  var match = /^(https?:\/\/[^\/]+)/.exec(settings.baseUrl);
+  if (!match) {
     return;
   }
 
-  console.log('Sending request to ' + providerName + ' API with ' + messages.length + ' messages');
+  var origin = match[1];
+  var now = Date.now();
+  if (lastWarmUp[origin] && now - lastWarmUp[origin] < WARM_UP_INTERVAL_MS) {
+    return;
+  }
+  lastWarmUp[origin] = now;
+
+  log.debug('Warming up connection to ' + origin);
 
+  // The response doesn't matter, only the connection it leaves in the pool
   var xhr = new XMLHttpRequest();
-  xhr.open('POST', baseUrl, true);
-  xhr.setRequestHeader('Content-Type', 'application/json');
+  xhr.open('HEAD', origin + '/', true);
+  xhr.timeout = 5000;
+  xhr.send();
+}
 
-  // Set provider-specific headers
+// Extract the response text from a successful API response
+function extractResponseText(provider, data) {
+  var responseText = '';
+
+  // Parse response based on provider format
   if (provider === 'claude') {
-    xhr.setRequestHeader('x-api-key', apiKey);
-    xhr.setRequestHeader('anthropic-version', '2023-06-01');
-  } else if (provider === 'openrouter') {
-    xhr.setRequestHeader('Authorization', 'Bearer ' + apiKey);
-    xhr.setRequestHeader('HTTP-Referer', 'https://github.com/breitburg/claude-for-pebble');
+    // Claude API format: content array with text blocks
+    if (data.content && data.content.length > 0) {
+      for (var i = 0; i < data.content.length; i++) {
+        var block = data.content[i];
+        if (block.type === 'text' && block.text) {
+          responseText += block.text;
+        } else if (block.type === 'server_tool_use') {
+          responseText += '\n\n';
+        }
+      }
+    }
   } else {
-    // OpenAI, Grok, and custom endpoints use Bearer token
-    xhr.setRequestHeader('Authorization', 'Bearer ' + apiKey);
+    // OpenAI/Grok/OpenRouter format: choices array with message.content
+    if (data.choices && data.choices.length > 0 && data.choices[0].message) {
+      responseText = data.choices[0].message.content || '';
+    }
   }
 
-  xhr.timeout = 5000;
+  return responseText.trim();
+}
+
+// HTTP statuses worth retrying: timeouts, rate limits and overload
+var RETRYABLE_STATUSES = [408, 429, 500, 502, 503, 504, 529];
+
+// Parse a retry-after-ms or retry-after header into milliseconds
+function parseRetryAfter(xhr) {
+  var ms = parseInt(xhr.getResponseHeader('retry-after-ms'), 10);
+  if (!isNaN(ms)) {
+    return ms;
+  }
+
+  var value = xhr.getResponseHeader('retry-after');
+  if (!value) {
+    return null;
+  }
+
+  // Either a number of seconds or an HTTP date
+  var seconds = parseFloat(value);
+  if (!isNaN(seconds)) {
+    return seconds * 1000;
+  }
+
+  var date = Date.parse(value);
+  return isNaN(date) ? null : Math.max(0, date - Date.now());
+}
+
+// Send a single request to the provider described by the template.
+// Calls handlers.onFirstByte() when response headers arrive, then exactly one
+// of handlers.onSuccess(text) or handlers.onFailure(message, failure), where
+// failure.retryable tells whether trying again may help and
+// failure.retryAfterMs carries the server's requested delay, if any.
+// Returns an object with an abort() method.
+function sendProviderRequest(template, messages, handlers) {
+  var settings = template.settings;
+  var providerName = settings.providerName;
+  var startTime = Date.now();
+  var gotFirstByte = false;
+  var aborted = false;
+
+  var xhr = new XMLHttpRequest();
+  xhr.open('POST', settings.baseUrl, true);
+
+  for (var header in template.headers) {
+    xhr.setRequestHeader(header, template.headers[header]);
+  }
+
+  xhr.timeout = latency.timeoutFor(template.latencyKey, settings.webSearchEnabled);
+
+  function firstByte() {
+    if (!gotFirstByte) {
+      gotFirstByte = true;
+      latency.record(template.latencyKey, 'ttfb', Date.now() - startTime);
+      handlers.onFirstByte();
+    }
+  }
+
+  xhr.onreadystatechange = function () {
+    if (xhr.readyState >= 2 && !aborted) {
+      firstByte();
+    }
+  };
 
   xhr.onload = function () {
+    firstByte();
+
     if (xhr.status === 200) {
-      try {
-        var data = JSON.parse(xhr.responseText);
-        var responseText = '';
-
-        // Parse response based on provider format
-        if (provider === 'claude') {
-          // Claude API format: content array with text blocks
-          if (data.content && data.content.length > 0) {
-            for (var i = 0; i < data.content.length; i++) {
-              var block = data.content[i];
-              if (block.type === 'text' && block.text) {
-                responseText += block.text;
-              } else if (block.type === 'server_tool_use') {
-                responseText += '\n\n';
-              }
-            }
-          }
-        } else {
-          // OpenAI/Grok/OpenRouter format: choices array with message.content
-          if (data.choices && data.choices.length > 0 && data.choices[0].message) {
-            responseText = data.choices[0].message.content || '';
-          }
-        }
+      latency.record(template.latencyKey, 'total', Date.now() - startTime);
 
-        responseText = responseText.trim();
+      try {
+        var responseText = extractResponseText(settings.provider, JSON.parse(xhr.responseText));
 
         if (responseText.length > 0) {
-          console.log('Sending response: ' + responseText);
-          Pebble.sendAppMessage({ 'RESPONSE_TEXT': responseText });
+          handlers.onSuccess(responseText);
         } else {
-          console.log('No text in response');
-          Pebble.sendAppMessage({ 'RESPONSE_TEXT': 'No response from ' + providerName });
+          log.warn('No text in response');
+          handlers.onSuccess('No response from ' + providerName);
         }
       } catch (e) {
-        console.log('Error parsing response: ' + e);
-        Pebble.sendAppMessage({ 'RESPONSE_TEXT': 'Error parsing response' });
+        log.error('Error parsing response: ' + e);
+        handlers.onFailure('Error parsing response', { retryable: false });
       }
     } else {
-      console.log('API error: ' + xhr.status + ' - ' + xhr.responseText);
+      log.error('API error: ' + xhr.status + ' - ' + log.summary(xhr.responseText));
       // Parse error response and extract message
       var errorMessage = xhr.responseText;
 
@@ -123,89 +272,429 @@ function getAIResponse(messages) {
           errorMessage = errorData.error.message;
         }
       } catch (e) {
-        console.log('Failed to parse error response: ' + e);
+        log.warn('Failed to parse error response: ' + e);
       }
 
-      // Send error
-      Pebble.sendAppMessage({ 'RESPONSE_TEXT': 'Error ' + xhr.status + ': ' + errorMessage });
+      handlers.onFailure('Error ' + xhr.status + ': ' + errorMessage, {
+        retryable: RETRYABLE_STATUSES.indexOf(xhr.status) !== -1,
+        retryAfterMs: parseRetryAfter(xhr)
+      });
     }
-
-    // Always send end signal
-    Pebble.sendAppMessage({ 'RESPONSE_END': 1 });
   };
 
   xhr.onerror = function () {
-    console.log('Network error');
-    Pebble.sendAppMessage({ 'RESPONSE_TEXT': 'Network error occurred' });
-    Pebble.sendAppMessage({ 'RESPONSE_END': 1 });
+    if (!aborted) {
+      log.warn('Network error');
+      handlers.onFailure('Network error occurred', { retryable: true });
+    }
   };
 
   xhr.ontimeout = function () {
-    console.log('Request timeout');
-    Pebble.sendAppMessage({ 'RESPONSE_TEXT': 'Request timed out. Try again later.' });
-    Pebble.sendAppMessage({ 'RESPONSE_END': 1 });
+    log.warn('Request timeout after ' + xhr.timeout + ' ms');
+    handlers.onFailure('Request timed out. Try again later.', { retryable: true });
   };
 
-  var requestBody = {
-    model: model,
-    max_tokens: 256,
-    messages: messages
+  var requestBody = {};
+  for (var field in template.body) {
+    requestBody[field] = template.body[field];
+  }
+  requestBody.messages = messages;
+
+  // OpenAI-style APIs: inject system message as first message
+  if (settings.provider !== 'claude' && settings.systemMessage) {
+    requestBody.messages = [{ role: 'system', content: settings.systemMessage }].concat(messages);
+  }
+
+  var payload = JSON.stringify(requestBody);
+  log.debug(function () {
+    return 'Request body: ' + log.summary(payload);
+  });
+  xhr.send(payload);
+
+  return {
+    abort: function () {
+      aborted = true;
+      xhr.abort();
+    }
   };
+}
 
-  // Provider-specific request body modifications
-  if (provider === 'claude') {
-    // Claude uses 'system' field separately
-    if (systemMessage) {
-      requestBody.system = systemMessage;
+// Retry limits: at most two retries, with full jitter over an exponential
+// backoff capped at 8 seconds. A server asking us to wait longer than the cap
+// gets no retry, the user is better served by the error.
+var MAX_RETRIES = 2;
+var RETRY_BASE_MS = 500;
+var RETRY_CAP_MS = 8000;
+
+// Delay before the given retry (0-based), or null to give up
+function retryDelay(retry, retryAfterMs) {
+  if (retryAfterMs !== null && retryAfterMs !== undefined) {
+    return retryAfterMs <= RETRY_CAP_MS ? retryAfterMs : null;
+  }
+  return Math.random() * Math.min(RETRY_CAP_MS, RETRY_BASE_MS * Math.pow(2, retry));
+}
+
+// Send a request with retries for retryable failures, going through the
+// provider's circuit breaker. Takes the same handlers as
+// sendProviderRequest(), plus an optional handlers.onRetrying(message)
+// called when a try failed and another one is scheduled.
+function sendWithRetry(template, messages, handlers) {
+  var key = template.circuitKey;
+  var retries = 0;
+  var request = null;
+  var retryTimer = null;
+
+  function attempt() {
+    request = null;
+
+    if (!circuit.allowRequest(key)) {
+      var seconds = Math.ceil(circuit.retryIn(key) / 1000);
+      log.info('Circuit open for ' + key + ', failing fast');
+      handlers.onFailure(template.settings.providerName + ' is not responding. Try again in ' + seconds + ' seconds.', { retryable: false });
+      return;
     }
 
-    // Add web search tool if enabled (Claude only)
-    if (webSearchEnabled) {
-      requestBody.tools = [{
-        type: 'web_search_20250305',
-        name: 'web_search',
-        max_uses: 5
-      }];
+    request = sendProviderRequest(template, messages, {
+      onFirstByte: handlers.onFirstByte,
+      onSuccess: function (text) {
+        request = null;
+        circuit.recordSuccess(key);
+        handlers.onSuccess(text);
+      },
+      onFailure: function (message, failure) {
+        request = null;
+
+        if (!failure.retryable) {
+          // The endpoint answered, it's just not something retrying can fix
+          circuit.recordSuccess(key);
+          handlers.onFailure(message, failure);
+          return;
+        }
+
+        circuit.recordFailure(key);
+
+        var delay = retryDelay(retries, failure.retryAfterMs);
+        if (retries < MAX_RETRIES && delay !== null && circuit.allowRequest(key)) {
+          circuit.abandon(key);
+          retries++;
+          log.warn('Retrying in ' + Math.round(delay) + ' ms (' + retries + '/' + MAX_RETRIES + '): ' + message);
+          if (handlers.onRetrying) {
+            handlers.onRetrying(message);
+          }
+          retryTimer = setTimeout(attempt, delay);
+        } else {
+          handlers.onFailure(message, failure);
+        }
+      }
+    });
+  }
+
+  attempt();
+
+  return {
+    abort: function () {
+      clearTimeout(retryTimer);
+      if (request) {
+        request.abort();
+        circuit.abandon(key);
+      }
     }
-  } else {
-    // OpenAI-style APIs: inject system message as first message
-    if (systemMessage) {
-      requestBody.messages = [{ role: 'system', content: systemMessage }].concat(messages);
+  };
+}
+
+// Hedge delay used until enough latency samples have been recorded
+var DEFAULT_HEDGE_DELAY_MS = 3000;
+
+// Get response from AI API, hedging to and failing over to the secondary
+// provider when one is configured
+function getAIResponse(messages, turnId) {
+  var primary = getRequestTemplate();
+  var secondary = getSecondaryTemplate();
+  var hedgeEnabled = localStorage.getItem('hedge_enabled') === 'true';
+
+  if (!primary.settings.apiKey) {
+    log.warn('No API key configured');
+    deliverResponse('No API key configured. Please configure in settings.', turnId);
+    return;
+  }
+
+  var attempts = [];
+  var pending = 0;
+  var finished = false;
+  var firstError = null;
+  var hedgeTimer = null;
+
+  function finish(text) {
+    finished = true;
+    clearTimeout(hedgeTimer);
+
+    // Abort whichever requests are still in flight
+    attempts.forEach(function (attempt) {
+      if (attempt.active) {
+        attempt.active = false;
+        attempt.request.abort();
+      }
+    });
+
+    log.debug(function () {
+      return 'Sending response: ' + log.summary(text);
+    });
+    deliverResponse(text, turnId);
+  }
+
+  function start(template, label) {
+    var attempt = { label: label, active: true };
+    attempts.push(attempt);
+    pending++;
+
+    log.info('Sending ' + label + ' request to ' + template.settings.provider + ' API with ' + messages.length + ' messages');
+
+    attempt.request = sendWithRetry(template, messages, {
+      onFirstByte: function () {
+        // Something is answering, no need to hedge anymore
+        clearTimeout(hedgeTimer);
+      },
+      onRetrying: function (message) {
+        // Don't wait out the backoff if there's somewhere else to ask
+        if (!finished && secondary && attempts.length === 1) {
+          log.warn(label + ' request is backing off, failing over: ' + message);
+          clearTimeout(hedgeTimer);
+          start(secondary, 'secondary');
+        }
+      },
+      onSuccess: function (text) {
+        if (finished || !attempt.active) return;
+        attempt.active = false;
+        log.info(label + ' request won');
+        finish(text);
+      },
+      onFailure: function (message) {
+        if (finished || !attempt.active) return;
+        attempt.active = false;
+        pending--;
+        firstError = firstError || message;
+
+        // Hard error, fail over right away if the secondary isn't running yet
+        if (secondary && attempts.length === 1) {
+          log.warn(label + ' request failed, failing over: ' + message);
+          clearTimeout(hedgeTimer);
+          start(secondary, 'secondary');
+        } else if (pending === 0) {
+          finish(firstError);
+        }
+      }
+    });
+  }
+
+  start(primary, 'primary');
+
+  if (secondary && hedgeEnabled) {
+    var percentile = parseInt(localStorage.getItem('hedge_percentile'), 10) || 95;
+    var hedgeDelay = latency.percentile(primary.latencyKey, 'ttfb', percentile) || DEFAULT_HEDGE_DELAY_MS;
+
+    hedgeTimer = setTimeout(function () {
+      if (!finished && attempts.length === 1) {
+        log.info('No first byte after ' + hedgeDelay + ' ms, hedging to secondary');
+        start(secondary, 'secondary');
+      }
+    }, hedgeDelay);
+  }
+}
+
+// Turn id of the question being answered, the watch may ask again while it is,
+// and the conversation it belongs to
+var activeTurn = 0;
+var activeConversation = 0;
+
+// Send a response (or error) to the watch and record it in the conversation log.
+// The watch uses turnId to drop answers it already has.
+function deliverResponse(text, turnId) {
+  var id = pager.deliver(text, turnId ? { 'TURN_ID': turnId } : null);
+  history.append(activeConversation, 'assistant', text, id);
+  if (turnId === activeTurn) {
+    activeTurn = 0;
+  }
+
+  // Probe candidate models once the user has been idle for a while
+  probe.schedule();
+}
+
+probe.init({
+  templateFor: getModelTemplate,
+  send: sendProviderRequest,
+  isBusy: function () {
+    return activeTurn !== 0;
+  },
+  onUpdate: function () {
+    // New measurements, pick the model again on the next turn
+    delete requestTemplates[''];
+  }
+});
+
+// Send the watch messages from the conversation log, one dictionary each,
+// walking towards older messages for a negative count
+function sendHistory(conversationId, index, count) {
+  var step = count < 0 ? -1 : 1;
+
+  for (var n = 0; n < Math.abs(count) && index >= 0; n++, index += step) {
+    var entry = history.get(conversationId, index);
+    if (!entry) {
+      // Tells the watch there is nothing more in this direction
+      dispatch.send({ 'CONVERSATION_ID': conversationId, 'HISTORY_INDEX': index });
+      return;
+    }
+
+    var dict = {
+      'CONVERSATION_ID': conversationId,
+      'HISTORY_INDEX': index,
+      'HISTORY_ROLE': entry.role === 'user' ? 0 : 1
+    };
+
+    // Response ids start over when the JS runtime restarts, so the pages
+    // kept under an old message's id may be another response's. Long
+    // messages of other conversations are paged again.
+    var pages = entry.responseId ? pager.pages(entry.responseId) : null;
+    if (pages && pages.join('') !== entry.content) {
+      pages = null;
+    }
+    if (!pages && entry.role === 'assistant' && pager.isLong(entry.content)) {
+      entry.responseId = pager.keep(entry.content);
+      pages = pager.pages(entry.responseId);
     }
+    if (pages && pages.length > 1) {
+      dict.RESPONSE_ID = entry.responseId;
+      dict.RESPONSE_PAGE_COUNT = pages.length;
+      dict.HISTORY_TEXT = pages[0];
+    } else {
+      dict.HISTORY_TEXT = entry.content;
+    }
+    dispatch.send(dict);
   }
+}
 
-  console.log('Request body: ' + JSON.stringify(requestBody));
-  xhr.send(JSON.stringify(requestBody));
+// Send the watch the conversation index from position start on, one
+// dictionary per conversation. Every one carries the number of conversations.
+function sendConversations(start, count) {
+  var total = history.count();
+  var items = history.list(start, count);
+
+  if (items.length === 0) {
+    dispatch.send({ 'CONVERSATION_TOTAL': total });
+    return;
+  }
+
+  items.forEach(function (item, i) {
+    dispatch.send({
+      'CONVERSATION_TOTAL': total,
+      'CONVERSATION_INDEX': start + i,
+      'CONVERSATION_ID': item.id,
+      'CONVERSATION_TITLE': item.title,
+      'CONVERSATION_UPDATED': item.updated,
+      'CONVERSATION_LENGTH': item.length
+    });
+  });
 }
 
+// Tell the watch when the main provider's circuit changes state
+circuit.onStateChange(function (key, state) {
+  if (key === getRequestTemplate().circuitKey) {
+    log.debug('Sending PROVIDER_STATUS: ' + state);
+    dispatch.send({ 'PROVIDER_STATUS': state });
+  }
+});
+
+// Power saving setting values, must match PowerSaving in power_policy.h
+var POWER_SAVING_VALUES = { 'auto': 0, 'always': 1, 'never': 2 };
+
 // Send ready status to watch
 function sendReadyStatus() {
   var apiKey = localStorage.getItem('api_key');
   var isReady = apiKey && apiKey.trim().length > 0 ? 1 : 0;
   var providerName = localStorage.getItem('provider_name') || 'AI';
-
-  console.log('Sending READY_STATUS: ' + isReady + ', PROVIDER_NAME: ' + providerName);
-  Pebble.sendAppMessage({ 'READY_STATUS': isReady, 'PROVIDER_NAME': providerName });
+  var powerSaving = POWER_SAVING_VALUES[localStorage.getItem('power_saving')] || 0;
+  var resumeWakeup = localStorage.getItem('resume_wakeup') === 'true' ? 1 : 0;
+
+  log.debug('Sending READY_STATUS: ' + isReady + ', PROVIDER_NAME: ' + providerName);
+  dispatch.send({
+    'READY_STATUS': isReady,
+    'PROVIDER_NAME': providerName,
+    'POWER_SAVING': powerSaving,
+    'RESUME_WAKEUP': resumeWakeup
+  });
 }
 
 // Listen for app ready
 Pebble.addEventListener('ready', function () {
-  console.log('PebbleKit JS ready');
+  log.info('PebbleKit JS ready');
+
+  var watch = Pebble.getActiveWatchInfo ? Pebble.getActiveWatchInfo() : null;
+  if (watch) {
+    dispatch.setPlatform(watch.platform);
+  }
+
   sendReadyStatus();
+  probe.schedule();
 });
 
 // Listen for messages from watch
 Pebble.addEventListener('appmessage', function (e) {
-  console.log('Received message from watch');
+  log.debug('Received message from watch');
+
+  if (e.payload.REQUEST_INTENT) {
+    // User started dictating, get the connections ready for the request
+    warmUpConnection(getRequestTemplate());
+
+    var secondary = getSecondaryTemplate();
+    if (secondary) {
+      warmUpConnection(secondary);
+    }
+  }
+
+  if ('REQUEST_PAGE' in e.payload && e.payload.RESPONSE_ID) {
+    // User scrolled close to the end (or start) of what the watch has of a response
+    pager.sendPage(e.payload.RESPONSE_ID, e.payload.REQUEST_PAGE);
+  }
+
+  if ('REQUEST_CONVERSATIONS' in e.payload) {
+    // The conversation menu is showing these rows
+    sendConversations(e.payload.REQUEST_CONVERSATIONS, e.payload.HISTORY_COUNT);
+  }
+
+  if ('REQUEST_HISTORY' in e.payload) {
+    // User scrolled past the oldest (or newest) message the watch has
+    sendHistory(e.payload.CONVERSATION_ID, e.payload.REQUEST_HISTORY, e.payload.HISTORY_COUNT);
+  }
 
   if (e.payload.REQUEST_CHAT) {
     var encoded = e.payload.REQUEST_CHAT;
-    console.log('REQUEST_CHAT received: ' + encoded);
+    log.debug('REQUEST_CHAT received: ' + encoded.length + ' bytes');
 
-    var messages = parseConversation(encoded);
-    console.log('Parsed ' + messages.length + ' messages');
+    if (e.payload.PAGE_BYTES) {
+      pager.setPageBytes(e.payload.PAGE_BYTES);
+    }
+
+    var turnId = e.payload.TURN_ID || 0;
+    var resident = conversation.decodeConversation(encoded, pager.fullText);
+    var messages = history.merge(e.payload.CONVERSATION_ID, e.payload.BASE_INDEX || 0, resident, turnId);
+    log.debug('Parsed ' + resident.length + ' messages, sending ' + messages.length);
 
-    getAIResponse(messages);
+    // A question sent again after the link dropped is answered only once
+    if (turnId && turnId === activeTurn) {
+      log.info('Turn ' + turnId + ' is already being answered');
+      return;
+    }
+
+    var previous = turnId ? history.answer(e.payload.CONVERSATION_ID, turnId) : null;
+    dispatch.beginTurn();
+    if (previous !== null) {
+      log.info('Turn ' + turnId + ' was answered already, sending the answer again');
+      pager.deliver(previous, { 'TURN_ID': turnId });
+      return;
+    }
+
+    activeTurn = turnId;
+    activeConversation = e.payload.CONVERSATION_ID;
+    getAIResponse(messages, turnId);
   }
 });
 
@@ -219,6 +708,17 @@ Pebble.addEventListener('showConfiguration', function () {
   var model = localStorage.getItem('model') || '';
   var systemMessage = localStorage.getItem('system_message') || '';
   var webSearchEnabled = localStorage.getItem('web_search_enabled') || 'false';
+  var secondaryProvider = localStorage.getItem('secondary_provider') || '';
+  var secondaryApiKey = localStorage.getItem('secondary_api_key') || '';
+  var secondaryBaseUrl = localStorage.getItem('secondary_base_url') || '';
+  var secondaryModel = localStorage.getItem('secondary_model') || '';
+  var hedgeEnabled = localStorage.getItem('hedge_enabled') || 'false';
+  var hedgePercentile = localStorage.getItem('hedge_percentile') || '';
+  var powerSaving = localStorage.getItem('power_saving') || 'auto';
+  var candidateModels = localStorage.getItem('candidate_models') || '';
+  var autoModelQuality = localStorage.getItem('auto_model_quality') || '';
+  var resumeWakeup = localStorage.getItem('resume_wakeup') || 'false';
+  var logLevel = localStorage.getItem('log_level') || 'info';
 
   // Build configuration URL - UPDATE THIS with your GitHub Pages URL
   var url = 'https://YOUR-USERNAME.github.io/YOUR-REPO-NAME/config/';
@@ -229,8 +729,21 @@ Pebble.addEventListener('showConfiguration', function () {
   url += '&model=' + encodeURIComponent(model);
   url += '&system_message=' + encodeURIComponent(systemMessage);
   url += '&web_search_enabled=' + encodeURIComponent(webSearchEnabled);
-
-  console.log('Opening configuration page: ' + url);
+  url += '&secondary_provider=' + encodeURIComponent(secondaryProvider);
+  url += '&secondary_api_key=' + encodeURIComponent(secondaryApiKey);
+  url += '&secondary_base_url=' + encodeURIComponent(secondaryBaseUrl);
+  url += '&secondary_model=' + encodeURIComponent(secondaryModel);
+  url += '&hedge_enabled=' + encodeURIComponent(hedgeEnabled);
+  url += '&hedge_percentile=' + encodeURIComponent(hedgePercentile);
+  url += '&power_saving=' + encodeURIComponent(powerSaving);
+  url += '&candidate_models=' + encodeURIComponent(candidateModels);
+  url += '&auto_model_quality=' + encodeURIComponent(autoModelQuality);
+  url += '&resume_wakeup=' + encodeURIComponent(resumeWakeup);
+  url += '&log_level=' + encodeURIComponent(logLevel);
+  url += '&model_latency=' + encodeURIComponent(JSON.stringify(probe.report()));
+
+  // Not the query, it holds the API keys
+  log.info('Opening configuration page: ' + url.split('?')[0]);
   Pebble.openURL(url);
 });
 
@@ -238,21 +751,29 @@ Pebble.addEventListener('showConfiguration', function () {
 Pebble.addEventListener('webviewclosed', function (e) {
   if (e && e.response) {
     var settings = JSON.parse(decodeURIComponent(e.response));
-    console.log('Settings received: ' + JSON.stringify(settings));
+    log.info('Settings received: ' + Object.keys(settings).length + ' fields');
 
     // Save or clear settings in local storage
-    var keys = ['provider', 'provider_name', 'api_key', 'base_url', 'model', 'system_message', 'web_search_enabled'];
+    var keys = ['provider', 'provider_name', 'api_key', 'base_url', 'model', 'system_message', 'web_search_enabled',
+                'secondary_provider', 'secondary_api_key', 'secondary_base_url', 'secondary_model',
+                'hedge_enabled', 'hedge_percentile', 'power_saving', 'candidate_models', 'auto_model_quality',
+                'resume_wakeup', 'log_level'];
     keys.forEach(function (key) {
       if (settings[key] && settings[key].trim() !== '') {
         localStorage.setItem(key, settings[key]);
-        console.log(key + ' saved');
+        log.debug(key + ' saved');
       } else {
         localStorage.removeItem(key);
-        console.log(key + ' cleared');
+        log.debug(key + ' cleared');
       }
     });
 
+    // Settings changed, rebuild the request template on next use
+    requestTemplates = {};
+    log.reload();
+
     // Send updated ready status to watch
     sendReadyStatus();
+    probe.schedule();
   }
 });
@@ -0,0 +1,89 @@
+// Rolling latency statistics per provider and model, kept in local storage
+// so they survive between app launches. Two metrics are tracked for each
+// key: 'ttfb' (time to first byte) and 'total' (time to complete response).
+
+var STORAGE_KEY = 'latency_stats';
+var MAX_SAMPLES = 20;
+
+var stats = null;
+
+function load() {
+  if (!stats) {
+    try {
+      stats = JSON.parse(localStorage.getItem(STORAGE_KEY)) || {};
+    } catch (e) {
+      stats = {};
+    }
+  }
+  return stats;
+}
+
+// Key identifying an endpoint and model combination. Web search turns are
+// tracked separately since they take several times longer.
+function keyFor(settings) {
+  var key = settings.provider + '|' + settings.baseUrl + '|' + settings.model;
+  return settings.webSearchEnabled ? key + '|search' : key;
+}
+
+function samplesFor(key, metric) {
+  var entry = load()[key];
+  if (!entry || entry instanceof Array) {
+    return null;
+  }
+  return entry[metric] || null;
+}
+
+// Record a sample in milliseconds for the given metric
+function record(key, metric, ms) {
+  var all = load();
+  if (!all[key] || all[key] instanceof Array) {
+    all[key] = {};
+  }
+
+  var samples = all[key][metric] || [];
+  samples.push(Math.round(ms));
+  if (samples.length > MAX_SAMPLES) {
+    samples.splice(0, samples.length - MAX_SAMPLES);
+  }
+
+  all[key][metric] = samples;
+  localStorage.setItem(STORAGE_KEY, JSON.stringify(all));
+}
+
+// Get the given percentile (0-100) of recorded samples, or null if there
+// aren't enough samples to say anything useful
+function percentile(key, metric, p, minSamples) {
+  var samples = samplesFor(key, metric);
+  if (!samples || samples.length < (minSamples || 5)) {
+    return null;
+  }
+
+  var sorted = samples.slice().sort(function (a, b) { return a - b; });
+  var index = Math.ceil((p / 100) * sorted.length) - 1;
+  return sorted[Math.max(0, Math.min(sorted.length - 1, index))];
+}
+
+// Defaults and bounds for request timeouts. The watch keeps its link fast for
+// up to MAX_TIMEOUT_MS (TURN_TIMEOUT_MS in chat_window.c).
+var DEFAULT_TIMEOUT_MS = 10000;
+var DEFAULT_SEARCH_TIMEOUT_MS = 30000;
+var MIN_TIMEOUT_MS = 4000;
+var MAX_TIMEOUT_MS = 60000;
+
+// Pick a request timeout from the observed completion times: twice the p95,
+// so slow but healthy responses get through while a dead endpoint is
+// detected much sooner than a fixed worst-case timeout would allow
+function timeoutFor(key, webSearch) {
+  var p95 = percentile(key, 'total', 95);
+  if (p95 === null) {
+    return webSearch ? DEFAULT_SEARCH_TIMEOUT_MS : DEFAULT_TIMEOUT_MS;
+  }
+  return Math.max(MIN_TIMEOUT_MS, Math.min(MAX_TIMEOUT_MS, p95 * 2 + 1000));
+}
+
+module.exports = {
+  keyFor: keyFor,
+  record: record,
+  percentile: percentile,
+  timeoutFor: timeoutFor
+};
@@ -0,0 +1,51 @@
+// Logging with levels. Messages below the current level are dropped before
+// they're built: pass a function instead of a string when building the
+// message costs something, it's only called if the message is logged.
+// Payloads (requests, responses, settings) are logged as size-bounded
+// summaries, never whole.
+
+var LEVELS = { error: 0, warn: 1, info: 2, debug: 3 };
+
+// Set from the log_level setting
+var DEFAULT_LEVEL = 'info';
+
+// Longest part of a payload that's logged
+var SUMMARY_CHARS = 80;
+
+var level = null;
+
+function currentLevel() {
+  if (level === null) {
+    var name = localStorage.getItem('log_level') || DEFAULT_LEVEL;
+    level = LEVELS.hasOwnProperty(name) ? LEVELS[name] : LEVELS[DEFAULT_LEVEL];
+  }
+  return level;
+}
+
+function write(messageLevel, message) {
+  if (messageLevel > currentLevel()) {
+    return;
+  }
+  console.log(typeof message === 'function' ? message() : message);
+}
+
+// The start of text, with its length when it's cut
+function summary(text, max) {
+  text = String(text);
+  max = max || SUMMARY_CHARS;
+  return text.length <= max ? text : text.slice(0, max) + '... (' + text.length + ' chars)';
+}
+
+// The level setting changed, read it again on the next message
+function reload() {
+  level = null;
+}
+
+module.exports = {
+  error: function (message) { write(LEVELS.error, message); },
+  warn: function (message) { write(LEVELS.warn, message); },
+  info: function (message) { write(LEVELS.info, message); },
+  debug: function (message) { write(LEVELS.debug, message); },
+  summary: summary,
+  reload: reload
+};
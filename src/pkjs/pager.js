@@ -0,0 +1,143 @@
+// Paged delivery of responses. The full text of recent responses is kept
+// here and the watch is sent one page at a time: the first page as soon as
+// the response arrives, later (or earlier) pages when the user scrolls close
+// to the end of what the watch has. Every page goes out as RESPONSE_TEXT
+// with RESPONSE_ID, RESPONSE_PAGE and RESPONSE_PAGE_COUNT.
+
+var dispatch = require('./dispatch');
+var log = require('./log');
+
+// Used until the watch sends PAGE_BYTES with a request
+var DEFAULT_PAGE_BYTES = 500;
+
+// Older responses are dropped, the watch then keeps what it has
+var MAX_RESPONSES = 16;
+
+// A page ends at the last space or line break in its final third, if any
+var BREAK_SEARCH_FRACTION = 2 / 3;
+
+var pageBytes = DEFAULT_PAGE_BYTES;
+var responses = {};
+var order = [];
+var nextId = 1;
+
+// UTF-8 size of one UTF-16 code unit. A surrogate pair counts 4 bytes on
+// the high half so pages never split a pair.
+function unitBytes(code) {
+  if (code < 0x80) return 1;
+  if (code < 0x800) return 2;
+  if (code >= 0xD800 && code < 0xDC00) return 4;
+  if (code >= 0xDC00 && code < 0xE000) return 0;
+  return 3;
+}
+
+function paginate(text, limit) {
+  var pages = [];
+  var start = 0;
+  var bytes = 0;
+  var lastBreak = -1;
+
+  for (var i = 0; i < text.length; i++) {
+    var size = unitBytes(text.charCodeAt(i));
+
+    if (bytes + size > limit) {
+      var end = (lastBreak > start && lastBreak - start >= (i - start) * BREAK_SEARCH_FRACTION) ? lastBreak : i;
+      pages.push(text.substring(start, end));
+
+      bytes = 0;
+      for (var j = end; j < i; j++) {
+        bytes += unitBytes(text.charCodeAt(j));
+      }
+      start = end;
+      lastBreak = -1;
+    }
+
+    bytes += size;
+    if (text[i] === ' ' || text[i] === '\n') {
+      lastBreak = i + 1;
+    }
+  }
+
+  pages.push(text.substring(start));
+  return pages;
+}
+
+// Page size the watch can hold, sent along with every chat request
+function setPageBytes(bytes) {
+  if (bytes > 0) {
+    pageBytes = bytes;
+  }
+}
+
+function sendPage(id, index, extra) {
+  var pages = responses[id];
+  if (!pages || index < 0 || index >= pages.length) {
+    // Tell the watch to stop asking for this response
+    log.warn('Response ' + id + ' page ' + index + ' is not available');
+    dispatch.send({ 'RESPONSE_ID': id, 'RESPONSE_PAGE_COUNT': 0 });
+    return;
+  }
+
+  var dict = {
+    'RESPONSE_ID': id,
+    'RESPONSE_PAGE': index,
+    'RESPONSE_PAGE_COUNT': pages.length,
+    'RESPONSE_TEXT': pages[index]
+  };
+  for (var key in extra) {
+    dict[key] = extra[key];
+  }
+  dispatch.send(dict);
+}
+
+// Keep a response to send page by page, returns its id
+function keep(text) {
+  var id = nextId;
+  nextId = nextId >= 0xFFFF ? 1 : nextId + 1;
+
+  responses[id] = paginate(text, pageBytes);
+  order.push(id);
+  while (order.length > MAX_RESPONSES) {
+    delete responses[order.shift()];
+  }
+
+  log.debug('Response ' + id + ' split into ' + responses[id].length + ' pages');
+  return id;
+}
+
+// Keep a response and send its first page, ending the turn. extra holds
+// more keys for that message.
+function deliver(text, extra) {
+  var id = keep(text);
+  var first = { 'RESPONSE_END': 1 };
+  for (var key in extra) {
+    first[key] = extra[key];
+  }
+  sendPage(id, 0, first);
+  return id;
+}
+
+// Whether text takes more than one page
+function isLong(text) {
+  return paginate(text, pageBytes).length > 1;
+}
+
+// Full text of a stored response, or null once it has been dropped
+function fullText(id) {
+  return responses[id] ? responses[id].join('') : null;
+}
+
+// Pages of a stored response, or null once it has been dropped
+function pages(id) {
+  return responses[id] || null;
+}
+
+module.exports = {
+  setPageBytes: setPageBytes,
+  keep: keep,
+  deliver: deliver,
+  sendPage: sendPage,
+  isLong: isLong,
+  fullText: fullText,
+  pages: pages
+};
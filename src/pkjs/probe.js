@@ -0,0 +1,225 @@
+// Latency probes of the candidate models, so turns can go to the fastest
+// model that's good enough. Candidates are configured as one model per line
+// with a quality tier (1-3), and turns use the fastest one at or above the
+// tier the user picked. Each candidate gets a tiny request now and then
+// while the phone is idle (and charging, when the phone can tell). Probe
+// timings are kept in latency.js under their own key, so candidates are
+// compared on the same request rather than on real turns of varying length.
+
+var latency = require('./latency');
+var log = require('./log');
+
+// How often each candidate is probed
+var PROBE_INTERVAL_MS = 6 * 60 * 60 * 1000;
+
+// Probes start once no turn has been asked for this long
+var IDLE_DELAY_MS = 60 * 1000;
+
+var PROBE_MESSAGES = [{ role: 'user', content: 'Reply with the word OK.' }];
+var PROBE_MAX_TOKENS = 8;
+
+// Time of the last probe and its error, if any, per model
+var STATE_KEY = 'model_probe_state';
+
+var MIN_TIER = 1;
+var MAX_TIER = 3;
+
+// Provided by index.js: templateFor(model), send(template, messages, handlers),
+// isBusy() and onUpdate()
+var hooks = null;
+var idleTimer = null;
+var probing = false;
+
+function loadState() {
+  try {
+    return JSON.parse(localStorage.getItem(STATE_KEY)) || {};
+  } catch (e) {
+    return {};
+  }
+}
+
+// [{ model, tier }] from the candidate_models setting, one "model tier" per line
+function candidates() {
+  var text = localStorage.getItem('candidate_models') || '';
+  var list = [];
+
+  text.split('\n').forEach(function (line) {
+    var parts = line.trim().split(/\s+/);
+    if (!parts[0]) {
+      return;
+    }
+
+    var tier = parseInt(parts[1], 10) || MIN_TIER;
+    list.push({ model: parts[0], tier: Math.max(MIN_TIER, Math.min(MAX_TIER, tier)) });
+  });
+  return list;
+}
+
+// Minimum tier for automatic selection, or 0 when it's off
+function minTier() {
+  return parseInt(localStorage.getItem('auto_model_quality'), 10) || 0;
+}
+
+function probeKey(model) {
+  return hooks.templateFor(model).latencyKey + '|probe';
+}
+
+// Median probe timing of a model for the given metric, or null before its first probe
+function median(model, metric) {
+  return latency.percentile(probeKey(model), metric, 50, 1);
+}
+
+// The model to answer turns with: the fastest healthy candidate at or above the
+// chosen tier, or the configured model until one has been measured
+function pick(configuredModel) {
+  var tier = minTier();
+  if (!hooks || tier === 0) {
+    return configuredModel;
+  }
+
+  var state = loadState();
+  var best = null;
+  var bestTotal = Infinity;
+
+  candidates().forEach(function (candidate) {
+    var total = median(candidate.model, 'total');
+    var healthy = !(state[candidate.model] && state[candidate.model].error);
+    if (candidate.tier >= tier && healthy && total !== null && total < bestTotal) {
+      best = candidate.model;
+      bestTotal = total;
+    }
+  });
+
+  return best || configuredModel;
+}
+
+// Measurements for the config page
+function report() {
+  if (!hooks) {
+    return [];
+  }
+
+  var state = loadState();
+  var chosen = pick(null);
+
+  return candidates().map(function (candidate) {
+    var probe = state[candidate.model] || {};
+    return {
+      model: candidate.model,
+      tier: candidate.tier,
+      ttfb: median(candidate.model, 'ttfb'),
+      total: median(candidate.model, 'total'),
+      at: probe.at || null,
+      error: probe.error || null,
+      chosen: candidate.model === chosen
+    };
+  });
+}
+
+// Calls back with false only when the phone says it's not charging
+function checkCharging(callback) {
+  if (typeof navigator === 'undefined' || !navigator.getBattery) {
+    callback(true);
+    return;
+  }
+
+  navigator.getBattery().then(function (battery) {
+    callback(battery.charging);
+  }, function () {
+    callback(true);
+  });
+}
+
+// Probe the candidates that are due, one at a time
+function probeDue() {
+  var state = loadState();
+  var now = Date.now();
+  var due = candidates().filter(function (candidate) {
+    var probe = state[candidate.model];
+    return !probe || now - probe.at >= PROBE_INTERVAL_MS;
+  });
+
+  function next() {
+    if (due.length === 0 || hooks.isBusy()) {
+      probing = false;
+      hooks.onUpdate();
+      return;
+    }
+
+    var candidate = due.shift();
+    var template = hooks.templateFor(candidate.model);
+    var body = {};
+    for (var field in template.body) {
+      body[field] = template.body[field];
+    }
+    body.max_tokens = PROBE_MAX_TOKENS;
+
+    var probeTemplate = {
+      settings: template.settings,
+      latencyKey: template.latencyKey + '|probe',
+      headers: template.headers,
+      body: body
+    };
+
+    function finish(error) {
+      state = loadState();
+      state[candidate.model] = { at: Date.now(), error: error };
+      localStorage.setItem(STATE_KEY, JSON.stringify(state));
+      next();
+    }
+
+    log.info('Probing ' + candidate.model);
+    hooks.send(probeTemplate, PROBE_MESSAGES, {
+      onFirstByte: function () {},
+      onSuccess: function () {
+        finish(null);
+      },
+      onFailure: function (message) {
+        finish(message);
+      }
+    });
+  }
+
+  if (due.length > 0) {
+    probing = true;
+    next();
+  }
+}
+
+function idleCheck() {
+  idleTimer = null;
+  if (minTier() === 0 || probing) {
+    return;
+  }
+
+  if (hooks.isBusy()) {
+    schedule();
+    return;
+  }
+
+  checkCharging(function (charging) {
+    if (charging) {
+      probeDue();
+    } else {
+      log.info('Not charging, model probes postponed');
+    }
+  });
+}
+
+// Wait for the phone to be idle, then probe whatever is due. Called whenever a
+// turn ends, so probes never compete with one.
+function schedule() {
+  clearTimeout(idleTimer);
+  idleTimer = setTimeout(idleCheck, IDLE_DELAY_MS);
+}
+
+function init(options) {
+  hooks = options;
+}
+
+module.exports = {
+  init: init,
+  schedule: schedule,
+  pick: pick,
+  report: report
+};
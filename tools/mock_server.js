@@ -0,0 +1,93 @@
+// Local mock of an AI provider endpoint for measuring the phone-side transport.
+//
+// Usage: node tools/mock_server.js [port] [options]
+//
+// Fault injection options:
+//   --fail-rate <0..1>    fraction of requests that fail (default 0)
+//   --status <code>       status code for failed requests (default 529)
+//   --retry-after <sec>   send a retry-after header with failed requests
+//   --drop                close the connection instead of answering failed requests
+//   --delay <ms>          delay before every response (default 0)
+//
+// Point the "Custom OpenAI-Compatible" provider at http://<host>:<port>/v1/chat/completions
+// (or any path ending in /messages for the Claude response format). Every request is
+// logged with the id of the TCP connection it arrived on, so connection reuse after a
+// warm-up is visible directly in the output.
+var http = require('http');
+
+var args = process.argv.slice(2);
+
+function option(name, fallback) {
+  var index = args.indexOf('--' + name);
+  return index === -1 ? fallback : args[index + 1];
+}
+
+var port = parseInt(args[0], 10) || 8787;
+var failRate = parseFloat(option('fail-rate', '0'));
+var failStatus = parseInt(option('status', '529'), 10);
+var retryAfter = option('retry-after', null);
+var drop = args.indexOf('--drop') !== -1;
+var delay = parseInt(option('delay', '0'), 10);
+var connectionCount = 0;
+var requestCount = 0;
+
+// Answer a request, failing it when fault injection says so
+function respond(req, res) {
+  requestCount++;
+  console.log('request #' + requestCount + ' ' + req.method + ' ' + req.url +
+              ' on connection #' + req.socket.connectionId +
+              ' (' + connectionCount + ' connections total)');
+
+  if (req.method !== 'POST') {
+    res.writeHead(204);
+    res.end();
+    return;
+  }
+
+  if (Math.random() < failRate) {
+    console.log('  injecting ' + (drop ? 'dropped connection' : failStatus));
+    if (drop) {
+      req.socket.destroy();
+      return;
+    }
+
+    var headers = { 'Content-Type': 'application/json' };
+    if (retryAfter !== null) {
+      headers['retry-after'] = retryAfter;
+    }
+    res.writeHead(failStatus, headers);
+    res.end(JSON.stringify({ error: { message: 'Injected failure' } }));
+    return;
+  }
+
+  var text = 'Mock response #' + requestCount;
+  var payload = /\/messages$/.test(req.url) ?
+    { content: [{ type: 'text', text: text }] } :
+    { choices: [{ message: { role: 'assistant', content: text } }] };
+
+  res.writeHead(200, { 'Content-Type': 'application/json' });
+  res.end(JSON.stringify(payload));
+}
+
+var server = http.createServer(function (req, res) {
+  // Drain the request body, the mock answers the same whatever was asked
+  req.resume();
+  req.on('end', function () {
+    setTimeout(function () {
+      respond(req, res);
+    }, delay);
+  });
+});
+
+server.on('connection', function (socket) {
+  connectionCount++;
+  socket.connectionId = connectionCount;
+  console.log('connection #' + connectionCount + ' opened');
+  socket.on('close', function () {
+    console.log('connection #' + socket.connectionId + ' closed');
+  });
+});
+
+server.listen(port, function () {
+  console.log('Mock provider listening on port ' + port);
+});
@@ -0,0 +1,136 @@
+// Turns the "PROF" lines logged by a profiler build (BIT_AI_PROFILER=1 pebble build)
+// into a per-build timing report.
+//
+// Usage: node tools/profile_report.js <log> [<log> ...]
+//
+// Each log is one build or setting, e.g. captured with `pebble logs --emulator basalt > before.log`.
+// Dumps are cumulative, so the last one in each log is used. With more than one log the
+// average of each point is compared against the first log, and the redraw and CPU time
+// saved on the drawing paths is estimated (e.g. power saving "never" vs "always" over the
+// same conversation), as is the round trip time gained for the time spent on the reduced
+// sniff interval (e.g. a BIT_AI_FAST_LINK=0 build vs the default one).
+var fs = require('fs');
+var path = require('path');
+
+var PROF_LINE = /PROF point=(\w+) count=(\d+) min=(\d+) avg=([\d.]+) max=(\d+)/;
+
+// Points that each mean one redraw of (part of) the screen
+var DRAW_POINTS = ['spark_draw', 'ui_update'];
+
+function parseLog(file) {
+  var points = {};
+  fs.readFileSync(file, 'utf8').split('\n').forEach(function (line) {
+    var match = PROF_LINE.exec(line);
+    if (match) {
+      points[match[1]] = {
+        count: parseInt(match[2], 10),
+        min: parseInt(match[3], 10),
+        avg: parseFloat(match[4]),
+        max: parseInt(match[5], 10)
+      };
+    }
+  });
+  return points;
+}
+
+function pad(value, width) {
+  value = String(value);
+  while (value.length < width) {
+    value = ' ' + value;
+  }
+  return value;
+}
+
+var files = process.argv.slice(2);
+if (files.length === 0) {
+  console.error('Usage: node tools/profile_report.js <log> [<log> ...]');
+  process.exit(1);
+}
+
+var builds = files.map(function (file) {
+  return { name: path.basename(file), points: parseLog(file) };
+});
+
+var names = [];
+builds.forEach(function (build) {
+  Object.keys(build.points).forEach(function (name) {
+    if (names.indexOf(name) < 0) {
+      names.push(name);
+    }
+  });
+});
+
+if (names.length === 0) {
+  console.error('No PROF lines found, was the app built with BIT_AI_PROFILER=1?');
+  process.exit(1);
+}
+
+builds.forEach(function (build, index) {
+  console.log(build.name);
+  console.log('  ' + pad('point', 16) + pad('count', 8) + pad('min', 6) + pad('avg', 9) + pad('max', 6) +
+              (index > 0 ? pad('avg vs ' + builds[0].name, 24) : ''));
+
+  names.forEach(function (name) {
+    var stats = build.points[name];
+    if (!stats) {
+      return;
+    }
+
+    var row = '  ' + pad(name, 16) + pad(stats.count, 8) + pad(stats.min, 6) +
+              pad(stats.avg.toFixed(2), 9) + pad(stats.max, 6);
+
+    var baseline = builds[0].points[name];
+    if (index > 0 && baseline && baseline.avg > 0) {
+      var change = (stats.avg - baseline.avg) / baseline.avg * 100;
+      row += pad((change >= 0 ? '+' : '') + change.toFixed(1) + '%', 24);
+    }
+    console.log(row);
+  });
+  console.log('');
+});
+
+// Total time of a point's samples, in ms
+function totalMs(build, name) {
+  var stats = build.points[name];
+  return stats ? stats.count * stats.avg : 0;
+}
+
+function averageMs(build, name) {
+  var stats = build.points[name];
+  return stats ? stats.avg : 0;
+}
+
+function drawCost(build) {
+  var cost = { count: 0, ms: 0 };
+  DRAW_POINTS.forEach(function (name) {
+    var stats = build.points[name];
+    if (stats) {
+      cost.count += stats.count;
+      cost.ms += stats.count * stats.avg;
+    }
+  });
+  return cost;
+}
+
+if (builds.length > 1) {
+  var baselineCost = drawCost(builds[0]);
+  builds.slice(1).forEach(function (build) {
+    var cost = drawCost(build);
+    console.log('Drawing vs ' + builds[0].name + ' in ' + build.name + ': ' +
+                (baselineCost.count - cost.count) + ' fewer redraws, ' +
+                (baselineCost.ms - cost.ms).toFixed(1) + ' ms less CPU time');
+
+    // Battery cost of the fast link is the extra time the radio spends on the reduced
+    // sniff interval, its gain the shorter round trips
+    var turns = build.points.turn_latency ? build.points.turn_latency.count : 0;
+    if (turns > 0) {
+      console.log('Link vs ' + builds[0].name + ' in ' + build.name + ': turns ' +
+                  (averageMs(builds[0], 'turn_latency') - averageMs(build, 'turn_latency')).toFixed(1) +
+                  ' ms faster, pages ' +
+                  (averageMs(builds[0], 'page_latency') - averageMs(build, 'page_latency')).toFixed(1) +
+                  ' ms faster, ' +
+                  ((totalMs(build, 'fast_link') - totalMs(builds[0], 'fast_link')) / turns).toFixed(0) +
+                  ' ms more on the reduced sniff interval per turn');
+    }
+  });
+}